@@ -0,0 +1,106 @@
+/* 
+*************************************************************
+Copyright  2013 Igor Kohanovsky e-mail: Igor.Kohanovsky@gmail.com
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*************************************************************
+*/
+#pragma once
+#ifndef __ALIGNEDALLOCATOR_H__
+#define __ALIGNEDALLOCATOR_H__
+
+#include <cstddef>
+#include <cstdlib>
+#include <limits>
+#include <new>
+#if defined _WIN32 || defined _WIN64
+#include <malloc.h>
+#endif
+
+namespace mns
+{
+// Alignment of the vector storage, it is enough for the aligned AVX-512 loads
+#define SIMD_ALIGNMENTBOUNDARY 64
+
+	template <typename T, std::size_t Alignment = SIMD_ALIGNMENTBOUNDARY>
+	class AlignedAllocator
+	{
+	// Allocates memory aligned at the Alignment boundary, so the vector data can be loaded by the aligned SIMD instructions
+	public:
+		typedef T value_type;
+		typedef T* pointer;
+		typedef const T* const_pointer;
+		typedef T& reference;
+		typedef const T& const_reference;
+		typedef std::size_t size_type;
+		typedef std::ptrdiff_t difference_type;
+
+		template <typename U>
+		struct rebind
+		{
+			typedef AlignedAllocator<U, Alignment> other;
+		};
+
+		AlignedAllocator() {};
+		AlignedAllocator(const AlignedAllocator&) {};
+		template <typename U>
+		AlignedAllocator(const AlignedAllocator<U, Alignment>&) {};
+
+		pointer       address(reference x) const { return &x; };
+		const_pointer address(const_reference x) const { return &x; };
+		size_type     max_size() const { return std::numeric_limits<size_type>::max() / sizeof(T); };
+
+		pointer allocate(size_type n, const void* = 0);
+		void    deallocate(pointer p, size_type) { Free(p); };
+
+		void construct(pointer p, const T& x) { new((void*)p) T(x); };
+		void destroy(pointer p) { p->~T(); };
+
+		bool operator ==(const AlignedAllocator&) const { return true; };
+		bool operator !=(const AlignedAllocator&) const { return false; };
+	private:
+		static void Free(void* p);
+	};
+
+	template <typename T, std::size_t Alignment>
+	typename AlignedAllocator<T, Alignment>::pointer AlignedAllocator<T, Alignment>::allocate(size_type n, const void*)
+	{
+		if( n == 0 )
+		{
+			return nullptr;
+		}
+		if( n > max_size() )
+		{
+			throw std::bad_alloc();
+		}
+
+		void* p = nullptr;
+#if defined _WIN32 || defined _WIN64
+		p = _aligned_malloc(n * sizeof(T), Alignment);
+#else
+		if( posix_memalign(&p, Alignment, n * sizeof(T)) != 0 )
+		{
+			p = nullptr;
+		}
+#endif
+		if( p == nullptr )
+		{
+			throw std::bad_alloc();
+		}
+		return static_cast<pointer>(p);
+	}
+
+	template <typename T, std::size_t Alignment>
+	void AlignedAllocator<T, Alignment>::Free(void* p)
+	{
+#if defined _WIN32 || defined _WIN64
+		_aligned_free(p);
+#else
+		free(p);
+#endif
+	}
+
+} // end of mns namespace
+
+#endif // __ALIGNEDALLOCATOR_H__
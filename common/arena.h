@@ -0,0 +1,139 @@
+/* 
+*************************************************************
+Copyright  2013 Igor Kohanovsky e-mail: Igor.Kohanovsky@gmail.com
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*************************************************************
+*/
+#pragma once
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <algorithm>
+#include <vector>
+#include "defs.h"
+
+namespace mns
+{
+	class Arena final
+	{
+	// Arena of scratch buffers
+	// Memory is taken from large blocks aligned at SIMD_ALIGNMENTBOUNDARY by moving a pointer and is given back
+	// in the stack order by Release() or ArenaScope. The blocks are kept until the arena is destroyed, so once
+	// the arena has grown to the peak demand, a repeated sequence of allocations does not touch the heap.
+	// Arena is not thread-safe.
+	public:
+		struct Mark
+		{
+			Size_T block;
+			Size_T offset;
+		};
+
+		explicit Arena(Size_T blockSize = DefaultBlockSize) : blockSize_(blockSize), current_(0), offset_(0) {};
+		~Arena();
+
+		// Returns an uninitialized buffer of n elements, T must be a trivial type
+		template <typename T>
+		T*     Allocate(Size_T n) { return static_cast<T*>(AllocateBytes(n * sizeof(T))); };
+		void*  AllocateBytes(Size_T bytes);
+
+		Mark   GetMark() const { Mark mark = { current_, offset_ }; return mark; };
+		void   Release(const Mark& mark) { current_ = mark.block; offset_ = mark.offset; };
+		Size_T GetCapacity() const;
+
+		static const Size_T DefaultBlockSize = 1 << 20; // bytes
+	private:
+		struct Block
+		{
+			unsigned char* data;
+			Size_T size;
+		};
+		static Block NewBlock(Size_T size);
+
+		std::vector<Block> blocks_;
+		Size_T blockSize_;
+		Size_T current_; // block being used
+		Size_T offset_;  // first free byte of the current block
+
+		Arena(const Arena&);
+		Arena& operator =(const Arena&);
+		Arena& operator =(Arena&&);
+	};
+
+	class ArenaScope final
+	{
+	// Gives back all the buffers taken from the arena during the lifetime of the scope
+	// A scope of nullptr arena does nothing
+	public:
+		explicit ArenaScope(Arena& arena) : arena_(&arena), mark_(arena.GetMark()) {};
+		explicit ArenaScope(Arena* arena) : arena_(arena), mark_(( arena != nullptr ) ? arena->GetMark() : Arena::Mark()) {};
+		~ArenaScope() { if( arena_ != nullptr ) { arena_->Release(mark_); } };
+	private:
+		Arena* arena_;
+		Arena::Mark mark_;
+
+		ArenaScope(const ArenaScope&);
+		ArenaScope& operator =(const ArenaScope&);
+	};
+
+	inline Arena::~Arena()
+	{
+		AlignedAllocator<unsigned char> allocator;
+		for( Size_T i = 0; i < blocks_.size(); ++i )
+		{
+			allocator.deallocate(blocks_[i].data, blocks_[i].size);
+		}
+	}
+
+	inline Arena::Block Arena::NewBlock(Size_T size)
+	{
+		Block block = { AlignedAllocator<unsigned char>().allocate(size), size };
+		return block;
+	}
+
+	inline void* Arena::AllocateBytes(Size_T bytes)
+	{
+		// Every buffer starts at the alignment boundary
+		bytes = std::max<Size_T>(1, (bytes + SIMD_ALIGNMENTBOUNDARY - 1) / SIMD_ALIGNMENTBOUNDARY) * SIMD_ALIGNMENTBOUNDARY;
+		if( current_ < blocks_.size() && offset_ + bytes <= blocks_[current_].size )
+		{
+			void* p = blocks_[current_].data + offset_;
+			offset_ += bytes;
+			return p;
+		}
+
+		// Go to the next block, the blocks after the current one are free and a too small one is replaced
+		if( current_ < blocks_.size() && offset_ > 0 )
+		{
+			++current_;
+		}
+		if( current_ == blocks_.size() )
+		{
+			blocks_.reserve(blocks_.size() + 1);
+			blocks_.push_back(NewBlock(std::max(blockSize_, bytes)));
+		}
+		else if( blocks_[current_].size < bytes )
+		{
+			Block block = NewBlock(std::max(blockSize_, bytes));
+			AlignedAllocator<unsigned char>().deallocate(blocks_[current_].data, blocks_[current_].size);
+			blocks_[current_] = block;
+		}
+
+		offset_ = bytes;
+		return blocks_[current_].data;
+	}
+
+	inline Size_T Arena::GetCapacity() const
+	{
+		Size_T capacity = 0;
+		for( Size_T i = 0; i < blocks_.size(); ++i )
+		{
+			capacity += blocks_[i].size;
+		}
+		return capacity;
+	}
+
+} // end of mns namespace
+
+#endif // __ARENA_H__
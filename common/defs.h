@@ -12,11 +12,10 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 
 #include <array>
 #include <vector>
+#include "alignedallocator.h"
 
 namespace mns 
 {
-#define SSE_ALIGNMENTBOUNDARY 16
-
 	template <typename T, int Dims>
 	struct Point
 	{
@@ -27,8 +26,8 @@ namespace mns
 	class Defs
 	{
 	public:
-		typedef typename std::vector<T> VectorT;
-		typedef typename VectorT SpdMatrixT;
+		typedef std::vector<T, AlignedAllocator<T>> VectorT; // storage is aligned at SIMD_ALIGNMENTBOUNDARY
+		typedef VectorT SpdMatrixT;
 		typedef typename std::vector<Point<T, Dims>> VectorP;
 	};
 
@@ -45,6 +44,13 @@ namespace mns
 		Failure = 0xE
 	};
 
+/* Storage layouts of SpdMatrixT */
+	enum class SpdLayout : unsigned int
+	{
+		Packed = 0x0, // lower triangle packed by rows
+		Rfp = 0x1     // Rectangular Full Packed format
+	};
+
 } // end of mns namespace
 
 #endif /* __DEFS_H__ */
@@ -0,0 +1,160 @@
+/* 
+*************************************************************
+Copyright  2013 Igor Kohanovsky e-mail: Igor.Kohanovsky@gmail.com
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*************************************************************
+*/
+#pragma once
+#ifndef __KDTREE_H__
+#define __KDTREE_H__
+
+#include <algorithm>
+#include <vector>
+#include "defs.h"
+
+namespace mns
+{
+	template <typename T, int Dims>
+	class KdTree final
+	{
+	// k-d tree of a point set: a node holds the points [begin, end) of the permuted order GetIndex() and their bounding box,
+	// an inner node is split at the median of the widest coordinate of its box, a leaf holds at most leafSize points
+	// Node 0 is the root. The points of a leaf are contiguous in the permuted order, so the callers keep their data
+	// (coordinates, coefficients) permuted by GetIndex() and process a leaf by contiguous vector loops.
+	public:
+		struct Node
+		{
+			T lo[Dims];
+			T hi[Dims];
+			int begin;
+			int end;
+			int left;  // -1 for a leaf
+			int right;
+		};
+
+		KdTree() {};
+
+		void Build(const T* soa, Size_T ld, int n, int leafSize = DefaultLeafSize);
+
+		const std::vector<Node>& GetNodes() const { return nodes_; };
+		const std::vector<int>&  GetIndex() const { return index_; }; // point index_[k] is the k-th one in the permuted order
+		int  GetNumPoints() const { return (int)index_.size(); };
+
+		// Calls f(begin, end) for the leaves whose boxes are within radius of q
+		template <typename F>
+		void ForEachLeaf(const T* q, T radius, F f) const;
+
+		static T GetDistance2(const Node& node, const T* q); // squared distance from q to the box of the node
+
+		static const int DefaultLeafSize = 64;
+	private:
+		int Split(const T* soa, Size_T ld, int begin, int end, int leafSize);
+
+		std::vector<Node> nodes_;
+		std::vector<int> index_;
+	};
+
+	template<typename T, int Dims>
+	void KdTree<T, Dims>::Build(const T* soa, Size_T ld, int n, int leafSize)
+	{
+	// Builds the tree of n points, coordinate k of point j is soa[k * ld + j]
+		nodes_.clear();
+		index_.resize(n);
+		for( int j = 0; j < n; ++j )
+		{
+			index_[j] = j;
+		}
+		if( n > 0 )
+		{
+			nodes_.reserve(2 * (n / std::max(1, leafSize) + 1));
+			Split(soa, ld, 0, n, std::max(1, leafSize));
+		}
+	}
+
+	template<typename T, int Dims>
+	int KdTree<T, Dims>::Split(const T* soa, Size_T ld, int begin, int end, int leafSize)
+	{
+	// Creates the node of the points [begin, end) and its subtree, returns the node number
+		int id = (int)nodes_.size();
+		nodes_.push_back(Node());
+		Node node;
+		node.begin = begin;
+		node.end = end;
+		node.left = -1;
+		node.right = -1;
+		int widest = 0;
+		for( int k = 0; k < Dims; ++k )
+		{
+			const T* x = soa + k * ld;
+			node.lo[k] = node.hi[k] = x[index_[begin]];
+			for( int j = begin + 1; j < end; ++j )
+			{
+				node.lo[k] = std::min(node.lo[k], x[index_[j]]);
+				node.hi[k] = std::max(node.hi[k], x[index_[j]]);
+			}
+			if( node.hi[k] - node.lo[k] > node.hi[widest] - node.lo[widest] )
+			{
+				widest = k;
+			}
+		}
+
+		if( end - begin > leafSize )
+		{
+			const T* x = soa + widest * ld;
+			int mid = begin + (end - begin) / 2;
+			std::nth_element(index_.begin() + begin, index_.begin() + mid, index_.begin() + end, [x](int a, int b) { return x[a] < x[b]; });
+			node.left = Split(soa, ld, begin, mid, leafSize);
+			node.right = Split(soa, ld, mid, end, leafSize);
+		}
+		nodes_[id] = node;
+		return id;
+	}
+
+	template<typename T, int Dims>
+	template <typename F>
+	void KdTree<T, Dims>::ForEachLeaf(const T* q, T radius, F f) const
+	{
+		if( nodes_.empty() )
+		{
+			return;
+		}
+		T r2 = radius * radius;
+		int stack[64];
+		int top = 0;
+		stack[top++] = 0;
+		while( top > 0 )
+		{
+			const Node& node = nodes_[stack[--top]];
+			if( GetDistance2(node, q) > r2 )
+			{
+				continue;
+			}
+			if( node.left < 0 )
+			{
+				f(node.begin, node.end);
+			}
+			else
+			{
+				stack[top++] = node.right;
+				stack[top++] = node.left;
+			}
+		}
+	}
+
+	template<typename T, int Dims>
+	T KdTree<T, Dims>::GetDistance2(const Node& node, const T* q)
+	{
+		T s = T(0.0);
+		for( int k = 0; k < Dims; ++k )
+		{
+			T d = std::max(node.lo[k] - q[k], std::max(T(0.0), q[k] - node.hi[k]));
+			s += d * d;
+		}
+		return s;
+	}
+
+} // end of mns namespace
+
+#endif // __KDTREE_H__
@@ -0,0 +1,206 @@
+/* 
+*************************************************************
+Copyright  2013 Igor Kohanovsky e-mail: Igor.Kohanovsky@gmail.com
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*************************************************************
+*/
+#pragma once
+#ifndef __REDUCTION_H__
+#define __REDUCTION_H__
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include "simd.h"
+#include "../service/threadpool.h"
+
+namespace mns
+{
+/* Accumulation of the reductions */
+	enum class Accumulation : unsigned int
+	{
+		Pairwise = 0x0,   // the lanes of Simd<T>::Dot within a chunk, the pairwise tree over the chunks
+		Compensated = 0x1 // Simd<T>::DotCompensated within a chunk, TwoSum in the tree: twice the working precision
+	};
+
+	template <typename T>
+	class Reduction final
+	{
+	// Deterministic dot products and norms: the result depends on the data and the accumulation only, not on the
+	// instruction set, the number of threads or the scheduling. The vectors are split into chunks of Chunk elements,
+	// every chunk is reduced by the Simd<T> kernels (fixed lanes, see SimdScalar<T>), possibly in parallel, and the
+	// partial sums of the chunks are added by the pairwise tree of Combine(), whose shape depends on their number only.
+	// The parallel versions take the loop of the caller: forEach(count, body) calls body(c) for c in [0, count), so
+	// every parallel backend (ThreadPool, OpenMP, PPL) supplies its loop only and gets the same results.
+	public:
+		struct Partial
+		{
+			T s; // sum
+			T c; // its correction, zero for Accumulation::Pairwise
+		};
+
+		static const int Chunk = 4096; // a multiple of the lanes of the kernels
+
+		static T Dot(const T* x, const T* y, int n, Accumulation acc = Accumulation::Pairwise, ThreadPool* pool = nullptr);
+		static T Norm2(const T* x, int n, Accumulation acc = Accumulation::Pairwise, ThreadPool* pool = nullptr) { return std::sqrt(Dot(x, x, n, acc, pool)); };
+		template <typename ForEach>
+		static T DotParallel(const T* x, const T* y, int n, Accumulation acc, ForEach forEach);
+		template <typename ForEach>
+		static T Norm2Parallel(const T* x, int n, Accumulation acc, ForEach forEach) { return std::sqrt(DotParallel(x, x, n, acc, forEach)); };
+
+		static int     GetNumChunks(int n) { return (n + Chunk - 1) / Chunk; };
+		static Partial DotChunk(const T* x, const T* y, int n, int c, Accumulation acc); // chunk c of x^T * y
+		static Partial ToPartial(T s) { Partial p = { s, T(0.0) }; return p; };
+		static T       Combine(Partial* partials, int count, Accumulation acc); // the partials are overwritten
+	private:
+		static void Add(Partial& a, const Partial& b, Accumulation acc);
+
+		static const int MaxLocalChunks = 64; // partial sums kept on the stack
+		Reduction();
+	};
+
+	template<typename T>
+	typename Reduction<T>::Partial Reduction<T>::DotChunk(const T* x, const T* y, int n, int c, Accumulation acc)
+	{
+		int jb = c * Chunk;
+		int len = std::min(n - jb, (int)Chunk);
+		Partial p;
+		if( acc == Accumulation::Compensated )
+		{
+			T s[2];
+			Simd<T>::DotCompensated(x + jb, y + jb, len, s);
+			p.s = s[0];
+			p.c = s[1];
+		}
+		else
+		{
+			p.s = Simd<T>::Dot(x + jb, y + jb, len);
+			p.c = T(0.0);
+		}
+		return p;
+	}
+
+	template<typename T>
+	void Reduction<T>::Add(Partial& a, const Partial& b, Accumulation acc)
+	{
+		if( acc == Accumulation::Compensated )
+		{
+			T t = a.s + b.s;
+			T z = t - a.s;
+			T e = (a.s - (t - z)) + (b.s - z);
+			a.s = t;
+			a.c = (a.c + b.c) + e;
+		}
+		else
+		{
+			a.s += b.s;
+		}
+	}
+
+	template<typename T>
+	T Reduction<T>::Combine(Partial* partials, int count, Accumulation acc)
+	{
+	// Adds partials[i + step] to partials[i] for step = 1, 2, 4, ... and i = 0, 2 * step, 4 * step, ...
+		if( count <= 0 )
+		{
+			return T(0.0);
+		}
+		for( int step = 1; step < count; step *= 2 )
+		{
+			for( int i = 0; i + step < count; i += 2 * step )
+			{
+				Add(partials[i], partials[i + step], acc);
+			}
+		}
+		return partials[0].s + partials[0].c;
+	}
+
+	template<typename T>
+	T Reduction<T>::Dot(const T* x, const T* y, int n, Accumulation acc, ThreadPool* pool)
+	{
+	// Returns x^T * y, the chunks are reduced on the pool if it is given
+		return DotParallel(x, y, n, acc, [pool](int count, const std::function<void(int)>& body)
+		{
+			if( pool != nullptr && pool->GetNumThreads() > 1 && count > 1 )
+			{
+				pool->ParallelFor(0, count, 1, [&](int lo, int hi)
+				{
+					for( int c = lo; c < hi; ++c )
+					{
+						body(c);
+					}
+				});
+			}
+			else
+			{
+				for( int c = 0; c < count; ++c )
+				{
+					body(c);
+				}
+			}
+		});
+	}
+
+	template<typename T>
+	template <typename ForEach>
+	T Reduction<T>::DotParallel(const T* x, const T* y, int n, Accumulation acc, ForEach forEach)
+	{
+	// Returns x^T * y, the chunks of a group are reduced by forEach
+	// The partials of a group of MaxLocalChunks chunks are kept on the stack and combined. The groups are aligned
+	// to a power of two, so the tree of Combine() over all the chunks is the tree within the groups followed by
+	// the tree over the groups; the latter is built by a binary counter (levels[l] is the sum of 2^l groups),
+	// so the result is the same as the one of Combine() over all the partials and no memory is allocated.
+		int chunks = GetNumChunks(n);
+		if( chunks <= 1 )
+		{
+			Partial p = ( n > 0 ) ? DotChunk(x, y, n, 0, acc) : ToPartial(T(0.0));
+			return p.s + p.c;
+		}
+
+		Partial local[MaxLocalChunks];
+		Partial levels[32];
+		unsigned int groups = 0;
+		for( int cb = 0; cb < chunks; cb += MaxLocalChunks )
+		{
+			int count = std::min(chunks - cb, (int)MaxLocalChunks);
+			forEach(count, [&](int c)
+			{
+				local[c] = DotChunk(x, y, n, cb + c, acc);
+			});
+			Combine(local, count, acc);
+
+			// A carry adds the group on the left to the one on the right, as Combine() does
+			Partial p = local[0];
+			int l = 0;
+			for( ; groups & (1u << l); ++l )
+			{
+				Add(levels[l], p, acc);
+				p = levels[l];
+			}
+			levels[l] = p;
+			++groups;
+		}
+
+		// The incomplete subtrees are added from the right, the lowest level is the rightmost one
+		Partial p = ToPartial(T(0.0));
+		bool first = true;
+		for( int l = 0; groups >> l; ++l )
+		{
+			if( groups & (1u << l) )
+			{
+				if( !first )
+				{
+					Add(levels[l], p, acc);
+				}
+				p = levels[l];
+				first = false;
+			}
+		}
+		return p.s + p.c;
+	}
+
+} // end of mns namespace
+
+#endif // __REDUCTION_H__
@@ -0,0 +1,1037 @@
+/* 
+*************************************************************
+Copyright  2013 Igor Kohanovsky e-mail: Igor.Kohanovsky@gmail.com
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*************************************************************
+*/
+#pragma once
+#ifndef __SIMD_H__
+#define __SIMD_H__
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#if !defined MNS_NO_SIMD && (defined _M_X64 || defined _M_IX86 || defined __x86_64__ || defined __i386__)
+#define MNS_SIMD_X86
+#include <immintrin.h>
+#if defined _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// AVX-512 intrinsics are available in gcc, clang and MSVC since VS2017
+#if defined MNS_SIMD_X86 && (defined __GNUC__ || defined __clang__ || (defined _MSC_VER && _MSC_VER >= 1910))
+#define MNS_SIMD_AVX512
+#endif
+
+// gcc and clang compile the intrinsics of an instruction set only inside the functions targeted at it,
+// so that the rest of the code does not depend on the compiler flags
+#if defined __GNUC__ || defined __clang__
+#define MNS_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define MNS_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma")))
+#else
+#define MNS_TARGET_AVX2
+#define MNS_TARGET_AVX512
+#endif
+
+namespace mns
+{
+/* Instruction sets of the vector kernels */
+	enum class SimdLevel : unsigned int
+	{
+		Scalar = 0x0,
+		Avx2 = 0x1,  // AVX2 + FMA
+		Avx512 = 0x2 // AVX-512F
+	};
+
+	inline SimdLevel DetectSimdLevel()
+	{
+	// Returns the best instruction set supported by the processor and the operating system
+#if defined MNS_SIMD_X86 && defined _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if( info[0] < 7 )
+		{
+			return SimdLevel::Scalar;
+		}
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool fma = (info[2] & (1 << 12)) != 0;
+		if( !osxsave || !fma )
+		{
+			return SimdLevel::Scalar;
+		}
+		unsigned long long xcr0 = _xgetbv(0);
+		__cpuidex(info, 7, 0);
+		bool avx2 = (info[1] & (1 << 5)) != 0 && (xcr0 & 0x6) == 0x6;
+		bool avx512 = (info[1] & (1 << 16)) != 0 && (xcr0 & 0xE6) == 0xE6;
+#if defined MNS_SIMD_AVX512
+		if( avx2 && avx512 )
+		{
+			return SimdLevel::Avx512;
+		}
+#endif
+		return avx2 ? SimdLevel::Avx2 : SimdLevel::Scalar;
+#elif defined MNS_SIMD_X86
+		__builtin_cpu_init();
+		if( __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") )
+		{
+			return SimdLevel::Avx512;
+		}
+		if( __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") )
+		{
+			return SimdLevel::Avx2;
+		}
+		return SimdLevel::Scalar;
+#else
+		return SimdLevel::Scalar;
+#endif
+	}
+
+	inline SimdLevel GetSimdLevel()
+	{
+	// The processor is queried once
+		static const SimdLevel level = DetectSimdLevel();
+		return level;
+	}
+
+	template <typename T>
+	class SimdScalar
+	{
+	// Scalar versions of the vector kernels, the fallback of the SIMD ones
+	// The reductions (Dot, Dot2x2, DotCompensated) give the same bits for every instruction set: element j is accumulated
+	// by fused multiply-add into lane j % lanes, where lanes is a multiple of the register width of all the sets,
+	// and the lanes are summed by the fixed tree of SumLanes. The scalar kernels emulate the lanes. Every product is
+	// formed by a fused multiply-add (x * y as fma(x, y, 0)), so the compilers cannot contract it with a following sum.
+	public:
+		static const int DotLanes = 256 / sizeof(T);           // of Dot, four AVX-512 registers
+		static const int Dot2x2Lanes = 64 / sizeof(T);         // of Dot2x2, one AVX-512 register
+		static const int CompensatedLanes = 128 / sizeof(T);   // of DotCompensated, two AVX-512 registers
+
+		static T    Dot(const T* x, const T* y, int n);
+		static void Dot2x2(const T* x0, const T* x1, const T* y0, const T* y1, int n, T* s);
+		static void DotCompensated(const T* x, const T* y, int n, T* s);
+		static T    SumLanes(T* acc, int lanes);
+		static void SumLanesCompensated(T* s, T* c, int lanes, T* sum);
+		static void Axpy(T a, const T* x, T* y, int n);
+		static void Axpy4(const T* a, const T* const* x, T* y, int n);
+		static void Distance(const T* x, std::size_t ld, int dims, const T* q, T* d, int n);
+		static void ExpPoly(const T* c, int m, T s, const T* x, T* y, int n) { ExpPolyM<-1>(c, m, s, x, y, n); };
+		template <int M>
+		static void ExpPoly(const T* c, T s, const T* x, T* y, int n) { ExpPolyM<M>(c, M, s, x, y, n); }; // the degree is known at compile time
+
+		template <int M>
+		static void ExpPolyM(const T* c, int m, T s, const T* x, T* y, int n);
+	protected:
+		SimdScalar();
+	};
+
+	template<typename T>
+	T SimdScalar<T>::SumLanes(T* acc, int lanes)
+	{
+	// Returns the sum of acc[0:lanes) (lanes is a power of 2) by the pairwise tree: lane l + h is added to lane l
+	// for h = lanes / 2, ..., 1, which is the order of the register folds and the horizontal sums of the vector kernels
+		for( int h = lanes / 2; h >= 1; h /= 2 )
+		{
+			for( int l = 0; l < h; ++l )
+			{
+				acc[l] += acc[l + h];
+			}
+		}
+		return acc[0];
+	}
+
+	template<typename T>
+	void SimdScalar<T>::SumLanesCompensated(T* s, T* c, int lanes, T* sum)
+	{
+	// The tree of SumLanes for the compensated lanes: the sums are added by TwoSum, their rounding errors
+	// are added to the corrections; sum[0] is the sum, sum[1] its correction
+		for( int h = lanes / 2; h >= 1; h /= 2 )
+		{
+			for( int l = 0; l < h; ++l )
+			{
+				T t = s[l] + s[l + h];
+				T z = t - s[l];
+				T e = (s[l] - (t - z)) + (s[l + h] - z);
+				s[l] = t;
+				c[l] = (c[l] + c[l + h]) + e;
+			}
+		}
+		sum[0] = s[0];
+		sum[1] = c[0];
+	}
+
+	template<typename T>
+	T SimdScalar<T>::Dot(const T* x, const T* y, int n)
+	{
+	// Returns x^T * y
+		const int lanes = DotLanes;
+		T acc[DotLanes];
+		std::fill(acc, acc + lanes, T(0.0));
+		for( int jb = 0; jb < n; jb += lanes )
+		{
+			int m = std::min(lanes, n - jb);
+			for( int l = 0; l < m; ++l )
+			{
+				acc[l] = std::fma(x[jb + l], y[jb + l], acc[l]);
+			}
+		}
+		return SumLanes(acc, lanes);
+	}
+
+	template<typename T>
+	void SimdScalar<T>::Dot2x2(const T* x0, const T* x1, const T* y0, const T* y1, int n, T* s)
+	{
+	// s = {x0^T * y0, x0^T * y1, x1^T * y0, x1^T * y1}, every loaded element is used twice
+		const int lanes = Dot2x2Lanes;
+		T acc[4][Dot2x2Lanes];
+		for( int k = 0; k < 4; ++k )
+		{
+			std::fill(acc[k], acc[k] + lanes, T(0.0));
+		}
+		for( int jb = 0; jb < n; jb += lanes )
+		{
+			int m = std::min(lanes, n - jb);
+			for( int l = 0; l < m; ++l )
+			{
+				int j = jb + l;
+				acc[0][l] = std::fma(x0[j], y0[j], acc[0][l]);
+				acc[1][l] = std::fma(x0[j], y1[j], acc[1][l]);
+				acc[2][l] = std::fma(x1[j], y0[j], acc[2][l]);
+				acc[3][l] = std::fma(x1[j], y1[j], acc[3][l]);
+			}
+		}
+		for( int k = 0; k < 4; ++k )
+		{
+			s[k] = SumLanes(acc[k], lanes);
+		}
+	}
+
+	template<typename T>
+	void SimdScalar<T>::DotCompensated(const T* x, const T* y, int n, T* s)
+	{
+	// Compensated x^T * y (Ogita, Rump, Oishi Dot2): the products are split exactly by TwoProduct (a fused multiply-add
+	// gives the rounding error), the sums by TwoSum, the errors are accumulated in corrections of the lanes;
+	// s[0] is the sum, s[1] its correction, the result is as accurate as if computed in twice the precision
+		const int lanes = CompensatedLanes;
+		T sl[CompensatedLanes];
+		T cl[CompensatedLanes];
+		std::fill(sl, sl + lanes, T(0.0));
+		std::fill(cl, cl + lanes, T(0.0));
+		for( int jb = 0; jb < n; jb += lanes )
+		{
+			int m = std::min(lanes, n - jb);
+			for( int l = 0; l < m; ++l )
+			{
+				T p = std::fma(x[jb + l], y[jb + l], T(0.0));
+				T ep = std::fma(x[jb + l], y[jb + l], -p);
+				T t = sl[l] + p;
+				T z = t - sl[l];
+				T e = (sl[l] - (t - z)) + (p - z);
+				sl[l] = t;
+				cl[l] = cl[l] + (e + ep);
+			}
+		}
+		SumLanesCompensated(sl, cl, lanes, s);
+	}
+
+	template<typename T>
+	void SimdScalar<T>::Axpy(T a, const T* x, T* y, int n)
+	{
+	// y += a * x
+		for( int j = 0; j < n; ++j )
+		{
+			y[j] += a * x[j];
+		}
+	}
+
+	template<typename T>
+	void SimdScalar<T>::Axpy4(const T* a, const T* const* x, T* y, int n)
+	{
+	// y += a[0] * x[0] + ... + a[3] * x[3], y is loaded and stored once for four vectors
+		T a0 = a[0], a1 = a[1], a2 = a[2], a3 = a[3];
+		const T* x0 = x[0];
+		const T* x1 = x[1];
+		const T* x2 = x[2];
+		const T* x3 = x[3];
+		for( int j = 0; j < n; ++j )
+		{
+			y[j] += a0 * x0[j] + a1 * x1[j] + a2 * x2[j] + a3 * x3[j];
+		}
+	}
+
+	template<typename T>
+	void SimdScalar<T>::Distance(const T* x, std::size_t ld, int dims, const T* q, T* d, int n)
+	{
+	// d[j] = |x_j - q|, coordinate k of the point x_j is x[k * ld + j] (structure of arrays)
+		for( int j = 0; j < n; ++j )
+		{
+			T s = T(0.0);
+			for( int k = 0; k < dims; ++k )
+			{
+				T t = x[k * ld + j] - q[k];
+				s += t * t;
+			}
+			d[j] = std::sqrt(s);
+		}
+	}
+
+	template<typename T>
+	template <int M>
+	void SimdScalar<T>::ExpPolyM(const T* c, int m, T s, const T* x, T* y, int n)
+	{
+	// y = exp(-t) * (c[0] * t^m + c[1] * t^(m-1) + ... + c[m]), t = s * x, y may coincide with x
+	// M >= 0 is the degree known at compile time (the Horner loop is unrolled), m is used for M = -1
+		if( M >= 0 )
+		{
+			m = M;
+		}
+		for( int j = 0; j < n; ++j )
+		{
+			T t = s * x[j];
+			T p = c[0];
+			for( int k = 1; k <= m; ++k )
+			{
+				p = p * t + c[k];
+			}
+			y[j] = std::exp(-t) * p;
+		}
+	}
+
+#if defined MNS_SIMD_X86
+	namespace simd
+	{
+	// Register types and operations of an instruction set, the kernels below are written in their terms
+		template <typename T> struct Avx2;
+
+		template <>
+		struct Avx2<double>
+		{
+			typedef __m256d V;
+			static const int Width = 4;
+			MNS_TARGET_AVX2 static V      Zero() { return _mm256_setzero_pd(); };
+			MNS_TARGET_AVX2 static V      Set(double a) { return _mm256_set1_pd(a); };
+			MNS_TARGET_AVX2 static V      Load(const double* p) { return _mm256_loadu_pd(p); };
+			MNS_TARGET_AVX2 static void   Store(double* p, V v) { _mm256_storeu_pd(p, v); };
+			MNS_TARGET_AVX2 static V      Fma(V a, V b, V c) { return _mm256_fmadd_pd(a, b, c); };
+			MNS_TARGET_AVX2 static V      Add(V a, V b) { return _mm256_add_pd(a, b); };
+			MNS_TARGET_AVX2 static V      Sub(V a, V b) { return _mm256_sub_pd(a, b); };
+			MNS_TARGET_AVX2 static V      Mul(V a, V b) { return _mm256_mul_pd(a, b); };
+			MNS_TARGET_AVX2 static V      Sqrt(V a) { return _mm256_sqrt_pd(a); };
+			MNS_TARGET_AVX2 static double Sum(V v)
+			{
+				__m128d s = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+				return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+			};
+			MNS_TARGET_AVX2 static V      Exp(V x)
+			{
+				// exp(x) = 2^k * exp(f), k = round(x / ln2), f = x - k * ln2 (ln2 is split in two parts), |f| <= ln2 / 2,
+				// exp(f) is its Taylor polynomial of degree 13. Results below the normal range are flushed to zero.
+				const V lo = _mm256_set1_pd(-708.39);
+				V under = _mm256_cmp_pd(x, lo, _CMP_GE_OQ);
+				x = _mm256_max_pd(_mm256_min_pd(x, _mm256_set1_pd(709.43)), lo);
+				V k = _mm256_round_pd(_mm256_mul_pd(x, _mm256_set1_pd(1.4426950408889634)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+				V f = _mm256_fnmadd_pd(k, _mm256_set1_pd(6.93145751953125E-1), x);
+				f = _mm256_fnmadd_pd(k, _mm256_set1_pd(1.42860682030941723212E-6), f);
+				V p = _mm256_set1_pd(1.0 / 6227020800.0);
+				p = _mm256_fmadd_pd(p, f, _mm256_set1_pd(1.0 / 479001600.0));
+				p = _mm256_fmadd_pd(p, f, _mm256_set1_pd(1.0 / 39916800.0));
+				p = _mm256_fmadd_pd(p, f, _mm256_set1_pd(1.0 / 3628800.0));
+				p = _mm256_fmadd_pd(p, f, _mm256_set1_pd(1.0 / 362880.0));
+				p = _mm256_fmadd_pd(p, f, _mm256_set1_pd(1.0 / 40320.0));
+				p = _mm256_fmadd_pd(p, f, _mm256_set1_pd(1.0 / 5040.0));
+				p = _mm256_fmadd_pd(p, f, _mm256_set1_pd(1.0 / 720.0));
+				p = _mm256_fmadd_pd(p, f, _mm256_set1_pd(1.0 / 120.0));
+				p = _mm256_fmadd_pd(p, f, _mm256_set1_pd(1.0 / 24.0));
+				p = _mm256_fmadd_pd(p, f, _mm256_set1_pd(1.0 / 6.0));
+				p = _mm256_fmadd_pd(p, f, _mm256_set1_pd(0.5));
+				p = _mm256_fmadd_pd(p, f, _mm256_set1_pd(1.0));
+				p = _mm256_fmadd_pd(p, f, _mm256_set1_pd(1.0));
+				// 2^k: k + 1023 lands in the low mantissa bits of k + 1023 + 1.5 * 2^52 and is shifted to the exponent field
+				__m256i e = _mm256_slli_epi64(_mm256_castpd_si256(_mm256_add_pd(k, _mm256_set1_pd(1023.0 + 6755399441055744.0))), 52);
+				return _mm256_and_pd(_mm256_mul_pd(p, _mm256_castsi256_pd(e)), under);
+			};
+		};
+
+		template <>
+		struct Avx2<float>
+		{
+			typedef __m256 V;
+			static const int Width = 8;
+			MNS_TARGET_AVX2 static V     Zero() { return _mm256_setzero_ps(); };
+			MNS_TARGET_AVX2 static V     Set(float a) { return _mm256_set1_ps(a); };
+			MNS_TARGET_AVX2 static V     Load(const float* p) { return _mm256_loadu_ps(p); };
+			MNS_TARGET_AVX2 static void  Store(float* p, V v) { _mm256_storeu_ps(p, v); };
+			MNS_TARGET_AVX2 static V     Fma(V a, V b, V c) { return _mm256_fmadd_ps(a, b, c); };
+			MNS_TARGET_AVX2 static V     Add(V a, V b) { return _mm256_add_ps(a, b); };
+			MNS_TARGET_AVX2 static V     Sub(V a, V b) { return _mm256_sub_ps(a, b); };
+			MNS_TARGET_AVX2 static V     Mul(V a, V b) { return _mm256_mul_ps(a, b); };
+			MNS_TARGET_AVX2 static V     Sqrt(V a) { return _mm256_sqrt_ps(a); };
+			MNS_TARGET_AVX2 static float Sum(V v)
+			{
+				__m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+				s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+				return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+			};
+			MNS_TARGET_AVX2 static V     Exp(V x)
+			{
+				// The double version with the Taylor polynomial of degree 7
+				const V lo = _mm256_set1_ps(-87.33f);
+				V under = _mm256_cmp_ps(x, lo, _CMP_GE_OQ);
+				x = _mm256_max_ps(_mm256_min_ps(x, _mm256_set1_ps(88.3f)), lo);
+				V k = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.44269504f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+				V f = _mm256_fnmadd_ps(k, _mm256_set1_ps(0.693359375f), x);
+				f = _mm256_fnmadd_ps(k, _mm256_set1_ps(-2.12194440e-4f), f);
+				V p = _mm256_set1_ps(1.0f / 5040.0f);
+				p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(1.0f / 720.0f));
+				p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(1.0f / 120.0f));
+				p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(1.0f / 24.0f));
+				p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(1.0f / 6.0f));
+				p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(0.5f));
+				p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(1.0f));
+				p = _mm256_fmadd_ps(p, f, _mm256_set1_ps(1.0f));
+				__m256i e = _mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(k), _mm256_set1_epi32(127)), 23);
+				return _mm256_and_ps(_mm256_mul_ps(p, _mm256_castsi256_ps(e)), under);
+			};
+		};
+
+		// The reductions keep the lanes of SimdScalar<T>: the tail of the vectors is copied to zero-padded blocks
+		// (adding the zero products leaves the lanes unchanged), the registers are folded in halves before the horizontal sum
+		template <typename T>
+		MNS_TARGET_AVX2 T DotAvx2(const T* x, const T* y, int n)
+		{
+			typedef Avx2<T> R;
+			const int w = R::Width;
+			const int lanes = SimdScalar<T>::DotLanes; // 8 registers
+			typename R::V s0 = R::Zero(), s1 = R::Zero(), s2 = R::Zero(), s3 = R::Zero();
+			typename R::V s4 = R::Zero(), s5 = R::Zero(), s6 = R::Zero(), s7 = R::Zero();
+			T bx[SimdScalar<T>::DotLanes];
+			T by[SimdScalar<T>::DotLanes];
+			for( int j = 0; j < n; j += lanes )
+			{
+				const T* px = x + j;
+				const T* py = y + j;
+				if( j + lanes > n )
+				{
+					std::fill(std::copy(x + j, x + n, bx), bx + lanes, T(0.0));
+					std::fill(std::copy(y + j, y + n, by), by + lanes, T(0.0));
+					px = bx;
+					py = by;
+				}
+				s0 = R::Fma(R::Load(px), R::Load(py), s0);
+				s1 = R::Fma(R::Load(px + w), R::Load(py + w), s1);
+				s2 = R::Fma(R::Load(px + 2 * w), R::Load(py + 2 * w), s2);
+				s3 = R::Fma(R::Load(px + 3 * w), R::Load(py + 3 * w), s3);
+				s4 = R::Fma(R::Load(px + 4 * w), R::Load(py + 4 * w), s4);
+				s5 = R::Fma(R::Load(px + 5 * w), R::Load(py + 5 * w), s5);
+				s6 = R::Fma(R::Load(px + 6 * w), R::Load(py + 6 * w), s6);
+				s7 = R::Fma(R::Load(px + 7 * w), R::Load(py + 7 * w), s7);
+			}
+			s0 = R::Add(s0, s4);
+			s1 = R::Add(s1, s5);
+			s2 = R::Add(s2, s6);
+			s3 = R::Add(s3, s7);
+			return R::Sum(R::Add(R::Add(s0, s2), R::Add(s1, s3)));
+		}
+
+		template <typename T>
+		MNS_TARGET_AVX2 void Dot2x2Avx2(const T* x0, const T* x1, const T* y0, const T* y1, int n, T* s)
+		{
+			typedef Avx2<T> R;
+			const int w = R::Width;
+			const int lanes = SimdScalar<T>::Dot2x2Lanes; // 2 registers per product
+			typename R::V s00 = R::Zero(), s01 = R::Zero(), s10 = R::Zero(), s11 = R::Zero();
+			typename R::V t00 = R::Zero(), t01 = R::Zero(), t10 = R::Zero(), t11 = R::Zero();
+			T buffer[4][SimdScalar<T>::Dot2x2Lanes];
+			for( int j = 0; j < n; j += lanes )
+			{
+				const T* p[4] = { x0 + j, x1 + j, y0 + j, y1 + j };
+				if( j + lanes > n )
+				{
+					const T* src[4] = { x0, x1, y0, y1 };
+					for( int k = 0; k < 4; ++k )
+					{
+						std::fill(std::copy(src[k] + j, src[k] + n, buffer[k]), buffer[k] + lanes, T(0.0));
+						p[k] = buffer[k];
+					}
+				}
+				typename R::V a0 = R::Load(p[0]), a1 = R::Load(p[1]);
+				typename R::V b0 = R::Load(p[2]), b1 = R::Load(p[3]);
+				s00 = R::Fma(a0, b0, s00);
+				s01 = R::Fma(a0, b1, s01);
+				s10 = R::Fma(a1, b0, s10);
+				s11 = R::Fma(a1, b1, s11);
+				a0 = R::Load(p[0] + w);
+				a1 = R::Load(p[1] + w);
+				b0 = R::Load(p[2] + w);
+				b1 = R::Load(p[3] + w);
+				t00 = R::Fma(a0, b0, t00);
+				t01 = R::Fma(a0, b1, t01);
+				t10 = R::Fma(a1, b0, t10);
+				t11 = R::Fma(a1, b1, t11);
+			}
+			s[0] = R::Sum(R::Add(s00, t00));
+			s[1] = R::Sum(R::Add(s01, t01));
+			s[2] = R::Sum(R::Add(s10, t10));
+			s[3] = R::Sum(R::Add(s11, t11));
+		}
+
+		template <typename R>
+		MNS_TARGET_AVX2 void TwoSumAvx2(typename R::V& s, typename R::V& c, typename R::V x, typename R::V y)
+		{
+		// One step of the compensated dot product, see SimdScalar<T>::DotCompensated
+			typename R::V p = R::Fma(x, y, R::Zero());
+			typename R::V ep = R::Fma(x, y, R::Sub(R::Zero(), p));
+			typename R::V t = R::Add(s, p);
+			typename R::V z = R::Sub(t, s);
+			typename R::V e = R::Add(R::Sub(s, R::Sub(t, z)), R::Sub(p, z));
+			s = t;
+			c = R::Add(c, R::Add(e, ep));
+		}
+
+		template <typename T>
+		MNS_TARGET_AVX2 void DotCompensatedAvx2(const T* x, const T* y, int n, T* s)
+		{
+			typedef Avx2<T> R;
+			const int w = R::Width;
+			const int lanes = SimdScalar<T>::CompensatedLanes; // 4 registers
+			typename R::V s0 = R::Zero(), s1 = R::Zero(), s2 = R::Zero(), s3 = R::Zero();
+			typename R::V c0 = R::Zero(), c1 = R::Zero(), c2 = R::Zero(), c3 = R::Zero();
+			T bx[SimdScalar<T>::CompensatedLanes];
+			T by[SimdScalar<T>::CompensatedLanes];
+			for( int j = 0; j < n; j += lanes )
+			{
+				const T* px = x + j;
+				const T* py = y + j;
+				if( j + lanes > n )
+				{
+					std::fill(std::copy(x + j, x + n, bx), bx + lanes, T(0.0));
+					std::fill(std::copy(y + j, y + n, by), by + lanes, T(0.0));
+					px = bx;
+					py = by;
+				}
+				TwoSumAvx2<R>(s0, c0, R::Load(px), R::Load(py));
+				TwoSumAvx2<R>(s1, c1, R::Load(px + w), R::Load(py + w));
+				TwoSumAvx2<R>(s2, c2, R::Load(px + 2 * w), R::Load(py + 2 * w));
+				TwoSumAvx2<R>(s3, c3, R::Load(px + 3 * w), R::Load(py + 3 * w));
+			}
+			R::Store(bx, s0);
+			R::Store(bx + w, s1);
+			R::Store(bx + 2 * w, s2);
+			R::Store(bx + 3 * w, s3);
+			R::Store(by, c0);
+			R::Store(by + w, c1);
+			R::Store(by + 2 * w, c2);
+			R::Store(by + 3 * w, c3);
+			SimdScalar<T>::SumLanesCompensated(bx, by, lanes, s);
+		}
+
+		template <typename T>
+		MNS_TARGET_AVX2 void AxpyAvx2(T a, const T* x, T* y, int n)
+		{
+			typedef Avx2<T> R;
+			const int w = R::Width;
+			typename R::V va = R::Set(a);
+			int j = 0;
+			for( ; j + 2 * w <= n; j += 2 * w )
+			{
+				R::Store(y + j, R::Fma(va, R::Load(x + j), R::Load(y + j)));
+				R::Store(y + j + w, R::Fma(va, R::Load(x + j + w), R::Load(y + j + w)));
+			}
+			for( ; j + w <= n; j += w )
+			{
+				R::Store(y + j, R::Fma(va, R::Load(x + j), R::Load(y + j)));
+			}
+			for( ; j < n; ++j )
+			{
+				y[j] += a * x[j];
+			}
+		}
+
+		template <typename T>
+		MNS_TARGET_AVX2 void Axpy4Avx2(const T* a, const T* const* x, T* y, int n)
+		{
+			typedef Avx2<T> R;
+			const int w = R::Width;
+			typename R::V a0 = R::Set(a[0]), a1 = R::Set(a[1]), a2 = R::Set(a[2]), a3 = R::Set(a[3]);
+			const T* x0 = x[0];
+			const T* x1 = x[1];
+			const T* x2 = x[2];
+			const T* x3 = x[3];
+			int j = 0;
+			for( ; j + w <= n; j += w )
+			{
+				typename R::V v = R::Fma(a0, R::Load(x0 + j), R::Load(y + j));
+				v = R::Fma(a1, R::Load(x1 + j), v);
+				v = R::Fma(a2, R::Load(x2 + j), v);
+				R::Store(y + j, R::Fma(a3, R::Load(x3 + j), v));
+			}
+			for( ; j < n; ++j )
+			{
+				y[j] += a[0] * x0[j] + a[1] * x1[j] + a[2] * x2[j] + a[3] * x3[j];
+			}
+		}
+
+		template <typename T>
+		MNS_TARGET_AVX2 void DistanceAvx2(const T* x, std::size_t ld, int dims, const T* q, T* d, int n)
+		{
+			typedef Avx2<T> R;
+			const int w = R::Width;
+			int j = 0;
+			for( ; j + w <= n; j += w )
+			{
+				typename R::V s = R::Zero();
+				for( int k = 0; k < dims; ++k )
+				{
+					typename R::V t = R::Sub(R::Load(x + k * ld + j), R::Set(q[k]));
+					s = R::Fma(t, t, s);
+				}
+				R::Store(d + j, R::Sqrt(s));
+			}
+			if( j < n )
+			{
+				SimdScalar<T>::Distance(x + j, ld, dims, q, d + j, n - j);
+			}
+		}
+
+		template <int M, typename T>
+		MNS_TARGET_AVX2 void ExpPolyAvx2(const T* c, int m, T s, const T* x, T* y, int n)
+		{
+			typedef Avx2<T> R;
+			if( M >= 0 )
+			{
+				m = M;
+			}
+			const int w = R::Width;
+			typename R::V vs = R::Set(s);
+			int j = 0;
+			for( ; j + w <= n; j += w )
+			{
+				typename R::V t = R::Mul(vs, R::Load(x + j));
+				typename R::V p = R::Set(c[0]);
+				for( int k = 1; k <= m; ++k )
+				{
+					p = R::Fma(p, t, R::Set(c[k]));
+				}
+				R::Store(y + j, R::Mul(p, R::Exp(R::Sub(R::Zero(), t))));
+			}
+			if( j < n )
+			{
+				SimdScalar<T>::template ExpPolyM<M>(c, m, s, x + j, y + j, n - j);
+			}
+		}
+
+#if defined MNS_SIMD_AVX512
+// GCC 12 -Wall reports -Wmaybe-uninitialized and -Wuninitialized for __Y in avx512fintrin.h: its unmasked sqrt, min,
+// max, scalef, roundscale and extractf64x4 (the horizontal sums) pass the undefined vector __Y (uninitialized on purpose)
+// as the merge source of the masked builtins. The false positive is silenced for the AVX-512 kernels only.
+#if defined __GNUC__ && !defined __clang__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+		template <typename T> struct Avx512;
+
+		template <>
+		struct Avx512<double>
+		{
+			typedef __m512d V;
+			static const int Width = 8;
+			MNS_TARGET_AVX512 static V      Zero() { return _mm512_setzero_pd(); };
+			MNS_TARGET_AVX512 static V      Set(double a) { return _mm512_set1_pd(a); };
+			MNS_TARGET_AVX512 static V      Load(const double* p) { return _mm512_loadu_pd(p); };
+			MNS_TARGET_AVX512 static V      Load(const double* p, int m) { return _mm512_maskz_loadu_pd((__mmask8)((1u << m) - 1), p); };
+			MNS_TARGET_AVX512 static void   Store(double* p, V v) { _mm512_storeu_pd(p, v); };
+			MNS_TARGET_AVX512 static void   Store(double* p, V v, int m) { _mm512_mask_storeu_pd(p, (__mmask8)((1u << m) - 1), v); };
+			MNS_TARGET_AVX512 static V      Fma(V a, V b, V c) { return _mm512_fmadd_pd(a, b, c); };
+			MNS_TARGET_AVX512 static V      Add(V a, V b) { return _mm512_add_pd(a, b); };
+			MNS_TARGET_AVX512 static V      Sub(V a, V b) { return _mm512_sub_pd(a, b); };
+			MNS_TARGET_AVX512 static V      Mul(V a, V b) { return _mm512_mul_pd(a, b); };
+			MNS_TARGET_AVX512 static V      Sqrt(V a) { return _mm512_sqrt_pd(a); };
+			MNS_TARGET_AVX512 static double Sum(V v)
+			{
+				// Halves are added down to one element, as by SimdScalar<T>::SumLanes
+				__m256d h = _mm256_add_pd(_mm512_castpd512_pd256(v), _mm512_extractf64x4_pd(v, 1));
+				__m128d s = _mm_add_pd(_mm256_castpd256_pd128(h), _mm256_extractf128_pd(h, 1));
+				return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+			};
+			MNS_TARGET_AVX512 static V      Exp(V x)
+			{
+				// The AVX2 scheme, 2^k is applied by scalef that also gives the underflow to zero
+				x = _mm512_max_pd(_mm512_min_pd(x, _mm512_set1_pd(1000.0)), _mm512_set1_pd(-1000.0));
+				V k = _mm512_roundscale_pd(_mm512_mul_pd(x, _mm512_set1_pd(1.4426950408889634)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+				V f = _mm512_fnmadd_pd(k, _mm512_set1_pd(6.93145751953125E-1), x);
+				f = _mm512_fnmadd_pd(k, _mm512_set1_pd(1.42860682030941723212E-6), f);
+				V p = _mm512_set1_pd(1.0 / 6227020800.0);
+				p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0 / 479001600.0));
+				p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0 / 39916800.0));
+				p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0 / 3628800.0));
+				p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0 / 362880.0));
+				p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0 / 40320.0));
+				p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0 / 5040.0));
+				p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0 / 720.0));
+				p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0 / 120.0));
+				p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0 / 24.0));
+				p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0 / 6.0));
+				p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(0.5));
+				p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0));
+				p = _mm512_fmadd_pd(p, f, _mm512_set1_pd(1.0));
+				return _mm512_scalef_pd(p, k);
+			};
+		};
+
+		template <>
+		struct Avx512<float>
+		{
+			typedef __m512 V;
+			static const int Width = 16;
+			MNS_TARGET_AVX512 static V     Zero() { return _mm512_setzero_ps(); };
+			MNS_TARGET_AVX512 static V     Set(float a) { return _mm512_set1_ps(a); };
+			MNS_TARGET_AVX512 static V     Load(const float* p) { return _mm512_loadu_ps(p); };
+			MNS_TARGET_AVX512 static V     Load(const float* p, int m) { return _mm512_maskz_loadu_ps((__mmask16)((1u << m) - 1), p); };
+			MNS_TARGET_AVX512 static void  Store(float* p, V v) { _mm512_storeu_ps(p, v); };
+			MNS_TARGET_AVX512 static void  Store(float* p, V v, int m) { _mm512_mask_storeu_ps(p, (__mmask16)((1u << m) - 1), v); };
+			MNS_TARGET_AVX512 static V     Fma(V a, V b, V c) { return _mm512_fmadd_ps(a, b, c); };
+			MNS_TARGET_AVX512 static V     Add(V a, V b) { return _mm512_add_ps(a, b); };
+			MNS_TARGET_AVX512 static V     Sub(V a, V b) { return _mm512_sub_ps(a, b); };
+			MNS_TARGET_AVX512 static V     Mul(V a, V b) { return _mm512_mul_ps(a, b); };
+			MNS_TARGET_AVX512 static V     Sqrt(V a) { return _mm512_sqrt_ps(a); };
+			MNS_TARGET_AVX512 static float Sum(V v)
+			{
+				__m256 h = _mm256_add_ps(_mm512_castps512_ps256(v), _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(v), 1)));
+				__m128 s = _mm_add_ps(_mm256_castps256_ps128(h), _mm256_extractf128_ps(h, 1));
+				s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+				return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
+			};
+			MNS_TARGET_AVX512 static V     Exp(V x)
+			{
+				x = _mm512_max_ps(_mm512_min_ps(x, _mm512_set1_ps(200.0f)), _mm512_set1_ps(-200.0f));
+				V k = _mm512_roundscale_ps(_mm512_mul_ps(x, _mm512_set1_ps(1.44269504f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+				V f = _mm512_fnmadd_ps(k, _mm512_set1_ps(0.693359375f), x);
+				f = _mm512_fnmadd_ps(k, _mm512_set1_ps(-2.12194440e-4f), f);
+				V p = _mm512_set1_ps(1.0f / 5040.0f);
+				p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(1.0f / 720.0f));
+				p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(1.0f / 120.0f));
+				p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(1.0f / 24.0f));
+				p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(1.0f / 6.0f));
+				p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(0.5f));
+				p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(1.0f));
+				p = _mm512_fmadd_ps(p, f, _mm512_set1_ps(1.0f));
+				return _mm512_scalef_ps(p, k);
+			};
+		};
+
+		// The AVX-512 kernels handle the tails by masked loads and stores
+		template <typename T>
+		MNS_TARGET_AVX512 T DotAvx512(const T* x, const T* y, int n)
+		{
+			typedef Avx512<T> R;
+			const int w = R::Width;
+			const int lanes = SimdScalar<T>::DotLanes; // 4 registers
+			typename R::V s0 = R::Zero(), s1 = R::Zero(), s2 = R::Zero(), s3 = R::Zero();
+			int j = 0;
+			for( ; j + lanes <= n; j += lanes )
+			{
+				s0 = R::Fma(R::Load(x + j), R::Load(y + j), s0);
+				s1 = R::Fma(R::Load(x + j + w), R::Load(y + j + w), s1);
+				s2 = R::Fma(R::Load(x + j + 2 * w), R::Load(y + j + 2 * w), s2);
+				s3 = R::Fma(R::Load(x + j + 3 * w), R::Load(y + j + 3 * w), s3);
+			}
+			if( j < n )
+			{
+				// The tail goes to the registers of its lanes, the masked loads give zeros beyond n
+				int m0 = std::min(w, n - j), m1 = std::max(0, std::min(w, n - j - w));
+				int m2 = std::max(0, std::min(w, n - j - 2 * w)), m3 = std::max(0, std::min(w, n - j - 3 * w));
+				s0 = R::Fma(R::Load(x + j, m0), R::Load(y + j, m0), s0);
+				s1 = R::Fma(R::Load(x + j + w, m1), R::Load(y + j + w, m1), s1);
+				s2 = R::Fma(R::Load(x + j + 2 * w, m2), R::Load(y + j + 2 * w, m2), s2);
+				s3 = R::Fma(R::Load(x + j + 3 * w, m3), R::Load(y + j + 3 * w, m3), s3);
+			}
+			return R::Sum(R::Add(R::Add(s0, s2), R::Add(s1, s3)));
+		}
+
+		template <typename R>
+		MNS_TARGET_AVX512 void TwoSumAvx512(typename R::V& s, typename R::V& c, typename R::V x, typename R::V y)
+		{
+			typename R::V p = R::Fma(x, y, R::Zero());
+			typename R::V ep = R::Fma(x, y, R::Sub(R::Zero(), p));
+			typename R::V t = R::Add(s, p);
+			typename R::V z = R::Sub(t, s);
+			typename R::V e = R::Add(R::Sub(s, R::Sub(t, z)), R::Sub(p, z));
+			s = t;
+			c = R::Add(c, R::Add(e, ep));
+		}
+
+		template <typename T>
+		MNS_TARGET_AVX512 void DotCompensatedAvx512(const T* x, const T* y, int n, T* s)
+		{
+			typedef Avx512<T> R;
+			const int w = R::Width;
+			const int lanes = SimdScalar<T>::CompensatedLanes; // 2 registers
+			typename R::V s0 = R::Zero(), s1 = R::Zero(), c0 = R::Zero(), c1 = R::Zero();
+			for( int j = 0; j < n; j += lanes )
+			{
+				int m0 = std::min(w, n - j), m1 = std::max(0, std::min(w, n - j - w));
+				TwoSumAvx512<R>(s0, c0, R::Load(x + j, m0), R::Load(y + j, m0));
+				TwoSumAvx512<R>(s1, c1, R::Load(x + j + w, m1), R::Load(y + j + w, m1));
+			}
+			T sl[SimdScalar<T>::CompensatedLanes];
+			T cl[SimdScalar<T>::CompensatedLanes];
+			R::Store(sl, s0);
+			R::Store(sl + w, s1);
+			R::Store(cl, c0);
+			R::Store(cl + w, c1);
+			SimdScalar<T>::SumLanesCompensated(sl, cl, lanes, s);
+		}
+
+		template <typename T>
+		MNS_TARGET_AVX512 void Dot2x2Avx512(const T* x0, const T* x1, const T* y0, const T* y1, int n, T* s)
+		{
+			typedef Avx512<T> R;
+			const int w = R::Width;
+			typename R::V s00 = R::Zero(), s01 = R::Zero(), s10 = R::Zero(), s11 = R::Zero();
+			for( int j = 0; j < n; j += w )
+			{
+				int m = std::min(w, n - j);
+				typename R::V a0 = R::Load(x0 + j, m), a1 = R::Load(x1 + j, m);
+				typename R::V b0 = R::Load(y0 + j, m), b1 = R::Load(y1 + j, m);
+				s00 = R::Fma(a0, b0, s00);
+				s01 = R::Fma(a0, b1, s01);
+				s10 = R::Fma(a1, b0, s10);
+				s11 = R::Fma(a1, b1, s11);
+			}
+			s[0] = R::Sum(s00);
+			s[1] = R::Sum(s01);
+			s[2] = R::Sum(s10);
+			s[3] = R::Sum(s11);
+		}
+
+		template <typename T>
+		MNS_TARGET_AVX512 void AxpyAvx512(T a, const T* x, T* y, int n)
+		{
+			typedef Avx512<T> R;
+			const int w = R::Width;
+			typename R::V va = R::Set(a);
+			int j = 0;
+			for( ; j + 2 * w <= n; j += 2 * w )
+			{
+				R::Store(y + j, R::Fma(va, R::Load(x + j), R::Load(y + j)));
+				R::Store(y + j + w, R::Fma(va, R::Load(x + j + w), R::Load(y + j + w)));
+			}
+			for( ; j + w <= n; j += w )
+			{
+				R::Store(y + j, R::Fma(va, R::Load(x + j), R::Load(y + j)));
+			}
+			if( j < n )
+			{
+				int m = n - j;
+				R::Store(y + j, R::Fma(va, R::Load(x + j, m), R::Load(y + j, m)), m);
+			}
+		}
+
+		template <typename T>
+		MNS_TARGET_AVX512 void Axpy4Avx512(const T* a, const T* const* x, T* y, int n)
+		{
+			typedef Avx512<T> R;
+			const int w = R::Width;
+			typename R::V a0 = R::Set(a[0]), a1 = R::Set(a[1]), a2 = R::Set(a[2]), a3 = R::Set(a[3]);
+			const T* x0 = x[0];
+			const T* x1 = x[1];
+			const T* x2 = x[2];
+			const T* x3 = x[3];
+			int j = 0;
+			for( ; j + w <= n; j += w )
+			{
+				typename R::V v = R::Fma(a0, R::Load(x0 + j), R::Load(y + j));
+				v = R::Fma(a1, R::Load(x1 + j), v);
+				v = R::Fma(a2, R::Load(x2 + j), v);
+				R::Store(y + j, R::Fma(a3, R::Load(x3 + j), v));
+			}
+			if( j < n )
+			{
+				int m = n - j;
+				typename R::V v = R::Fma(a0, R::Load(x0 + j, m), R::Load(y + j, m));
+				v = R::Fma(a1, R::Load(x1 + j, m), v);
+				v = R::Fma(a2, R::Load(x2 + j, m), v);
+				R::Store(y + j, R::Fma(a3, R::Load(x3 + j, m), v), m);
+			}
+		}
+
+		template <typename T>
+		MNS_TARGET_AVX512 void DistanceAvx512(const T* x, std::size_t ld, int dims, const T* q, T* d, int n)
+		{
+			typedef Avx512<T> R;
+			const int w = R::Width;
+			for( int j = 0; j < n; j += w )
+			{
+				int l = std::min(w, n - j);
+				typename R::V s = R::Zero();
+				for( int k = 0; k < dims; ++k )
+				{
+					typename R::V t = R::Sub(R::Load(x + k * ld + j, l), R::Set(q[k]));
+					s = R::Fma(t, t, s);
+				}
+				R::Store(d + j, R::Sqrt(s), l);
+			}
+		}
+
+		template <int M, typename T>
+		MNS_TARGET_AVX512 void ExpPolyAvx512(const T* c, int m, T s, const T* x, T* y, int n)
+		{
+			typedef Avx512<T> R;
+			if( M >= 0 )
+			{
+				m = M;
+			}
+			const int w = R::Width;
+			typename R::V vs = R::Set(s);
+			for( int j = 0; j < n; j += w )
+			{
+				int l = std::min(w, n - j);
+				typename R::V t = R::Mul(vs, R::Load(x + j, l));
+				typename R::V p = R::Set(c[0]);
+				for( int k = 1; k <= m; ++k )
+				{
+					p = R::Fma(p, t, R::Set(c[k]));
+				}
+				R::Store(y + j, R::Mul(p, R::Exp(R::Sub(R::Zero(), t))), l);
+			}
+		}
+#if defined __GNUC__ && !defined __clang__
+#pragma GCC diagnostic pop
+#endif
+#endif // MNS_SIMD_AVX512
+
+		template <typename T>
+		class Dispatch
+		{
+		// Selects the kernel of the best available instruction set, falls back to the scalar one
+		public:
+			static T Dot(const T* x, const T* y, int n)
+			{
+				switch( GetSimdLevel() )
+				{
+#if defined MNS_SIMD_AVX512
+				case SimdLevel::Avx512: return DotAvx512(x, y, n);
+#endif
+				case SimdLevel::Avx2:   return DotAvx2(x, y, n);
+				default:                return SimdScalar<T>::Dot(x, y, n);
+				}
+			};
+
+			static void DotCompensated(const T* x, const T* y, int n, T* s)
+			{
+				switch( GetSimdLevel() )
+				{
+#if defined MNS_SIMD_AVX512
+				case SimdLevel::Avx512: DotCompensatedAvx512(x, y, n, s); break;
+#endif
+				case SimdLevel::Avx2:   DotCompensatedAvx2(x, y, n, s); break;
+				default:                SimdScalar<T>::DotCompensated(x, y, n, s); break;
+				}
+			};
+
+			static void Dot2x2(const T* x0, const T* x1, const T* y0, const T* y1, int n, T* s)
+			{
+				switch( GetSimdLevel() )
+				{
+#if defined MNS_SIMD_AVX512
+				case SimdLevel::Avx512: Dot2x2Avx512(x0, x1, y0, y1, n, s); break;
+#endif
+				case SimdLevel::Avx2:   Dot2x2Avx2(x0, x1, y0, y1, n, s); break;
+				default:                SimdScalar<T>::Dot2x2(x0, x1, y0, y1, n, s); break;
+				}
+			};
+
+			static void Axpy(T a, const T* x, T* y, int n)
+			{
+				switch( GetSimdLevel() )
+				{
+#if defined MNS_SIMD_AVX512
+				case SimdLevel::Avx512: AxpyAvx512(a, x, y, n); break;
+#endif
+				case SimdLevel::Avx2:   AxpyAvx2(a, x, y, n); break;
+				default:                SimdScalar<T>::Axpy(a, x, y, n); break;
+				}
+			};
+
+			static void Axpy4(const T* a, const T* const* x, T* y, int n)
+			{
+				switch( GetSimdLevel() )
+				{
+#if defined MNS_SIMD_AVX512
+				case SimdLevel::Avx512: Axpy4Avx512(a, x, y, n); break;
+#endif
+				case SimdLevel::Avx2:   Axpy4Avx2(a, x, y, n); break;
+				default:                SimdScalar<T>::Axpy4(a, x, y, n); break;
+				}
+			};
+
+			static void Distance(const T* x, std::size_t ld, int dims, const T* q, T* d, int n)
+			{
+				switch( GetSimdLevel() )
+				{
+#if defined MNS_SIMD_AVX512
+				case SimdLevel::Avx512: DistanceAvx512(x, ld, dims, q, d, n); break;
+#endif
+				case SimdLevel::Avx2:   DistanceAvx2(x, ld, dims, q, d, n); break;
+				default:                SimdScalar<T>::Distance(x, ld, dims, q, d, n); break;
+				}
+			};
+
+			static void ExpPoly(const T* c, int m, T s, const T* x, T* y, int n) { ExpPolyM<-1>(c, m, s, x, y, n); };
+			template <int M>
+			static void ExpPoly(const T* c, T s, const T* x, T* y, int n) { ExpPolyM<M>(c, M, s, x, y, n); };
+
+			template <int M>
+			static void ExpPolyM(const T* c, int m, T s, const T* x, T* y, int n)
+			{
+				switch( GetSimdLevel() )
+				{
+#if defined MNS_SIMD_AVX512
+				case SimdLevel::Avx512: ExpPolyAvx512<M>(c, m, s, x, y, n); break;
+#endif
+				case SimdLevel::Avx2:   ExpPolyAvx2<M>(c, m, s, x, y, n); break;
+				default:                SimdScalar<T>::template ExpPolyM<M>(c, m, s, x, y, n); break;
+				}
+			};
+		protected:
+			Dispatch();
+		};
+	} // end of simd namespace
+#endif // MNS_SIMD_X86
+
+	template <typename T>
+	class Simd : public SimdScalar<T>
+	{
+	// Vector kernels of the linear algebra routines: Dot (x^T * y), Dot2x2 (four dot products of two pairs), DotCompensated (x^T * y in twice the precision),
+	// Axpy (y += a * x), Axpy4 (y += a[0] * x[0] + ... + a[3] * x[3]),
+	// Distance (distances from a point to the points kept as structure of arrays), ExpPoly (exp(-t) times a polynomial of t = s * x, the reproducing kernels)
+	// The float and double kernels use the instruction set selected at run time by GetSimdLevel(), other types use the scalar ones;
+	// the reductions give the same bits for all of them (see SimdScalar<T>)
+	private:
+		Simd();
+	};
+
+#if defined MNS_SIMD_X86
+	template <>
+	class Simd<double> : public simd::Dispatch<double>
+	{
+	private:
+		Simd();
+	};
+
+	template <>
+	class Simd<float> : public simd::Dispatch<float>
+	{
+	private:
+		Simd();
+	};
+#endif
+
+} // end of mns namespace
+
+#endif // __SIMD_H__
@@ -14,6 +14,8 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #include <functional>
 #include <numeric>
 #include "ihelper.h"
+#include "spmv.h"
+#include "../service/probe.h"
 
 namespace mns 
 {
@@ -22,13 +24,16 @@ namespace mns
 	{
 	// Implements common vector/matrix operations
 	public:
+		typedef typename IHelper<T>::VectorT VectorT;
+		typedef typename IHelper<T>::SpdMatrixT SpdMatrixT;
+
 		Helper1() {};
 	private:
 		virtual VectorT GetResidualImpl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const override;
+		virtual void GetResidualImpl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b, VectorT& r) const override;
+		virtual T GetResidualNorm2Impl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const override;
 		virtual T GetVectorNorm2Impl(int n, const VectorT& v) const override;
 
-		virtual T GetGamma2Impl(int n) const override;
-
 		Helper1(const Helper1&);
 		Helper1& operator =(const Helper1&);
 		Helper1& operator =(Helper1&&);
@@ -37,40 +42,43 @@ namespace mns
 	template<typename T> 
 	T Helper1<T>::GetVectorNorm2Impl(int n, const VectorT& v) const
 	{
-		T s = T(0.0);
-		s = std::inner_product(v.begin(), v.end(), v.begin(), s);
-		return std::sqrt(s);
+		MNS_PROBE(Norm);
+		return ( n > 0 ) ? Reduction<T>::Norm2(&v[0], n, this->GetAccumulation()) : T(0.0);
 	}
 
 	template<typename T> 
 	typename Helper1<T>::VectorT Helper1<T>::GetResidualImpl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const
 	{
-		VectorT r(n);
-		for( int i = 0; i < n; ++i )
+		VectorT r;
+		GetResidualImpl(n, a, x, b, r);
+		return r;
+	}
+
+	template<typename T> 
+	void Helper1<T>::GetResidualImpl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b, VectorT& r) const
+	{
+	// The packed triangle is read once by rows, see SpMv<T>
+		MNS_PROBE(Residual);
+		r.resize(n);
+		if( n > 0 )
 		{
-			r[i] = T(0.0);
-			for( int j = 0; j < i; ++j )
-			{
-				r[i] += a[j + ((Size_T)i) * (i + 1) / 2] * x[j];
-			}
-			for( int j = i; j < n; ++j )
-			{
-				r[i] += a[i + ((Size_T)j) * (j + 1) / 2] * x[j];
-			}
-			r[i] = b[i] - r[i];
+			SpMv<T>::Residual(n, &a[0], &x[0], &b[0], &r[0]);
 		}
-		return r;
 	}
 
-    template<typename T> 
-	T Helper1<T>::GetGamma2Impl(int n) const
+	template<typename T> 
+	T Helper1<T>::GetResidualNorm2Impl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const
 	{
-		T s = T(1.0);
-		for( int i = 1; i <= n; ++i )
+	// Computes ||b - A * x||_2 in one pass over the matrix without forming the residual vector,
+	// the partial sums of the residual are kept in a scratch buffer of the arena
+		MNS_PROBE(Residual);
+		if( n <= 0 )
 		{
-			s *= ((T(2.0)*i - 1)/2.0);
+			return T(0.0);
 		}
-		return s*SQRTPI();
+		ArenaScope scope(this->GetArena());
+		T* scratch = this->GetArena().template Allocate<T>(n);
+		return SpMv<T>::ResidualNorm2(n, &a[0], &x[0], &b[0], scratch);
 	}
 
 } // end of mns namespace
@@ -15,17 +15,22 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #include <numeric>
 #include <amp.h>
 #include "ihelper.h"
+#include "spmv.h"
+#include "../service/probe.h"
 
 using namespace concurrency;
 
 namespace mns 
 {
 	template <typename T>
-	class Helper1 final : public IHelper<T>
+	class HelperAmp final : public IHelper<T>
 	{
 	// Implements common vector/matrix operations
 	public:
-		Helper1() {};
+		typedef typename IHelper<T>::VectorT VectorT;
+		typedef typename IHelper<T>::SpdMatrixT SpdMatrixT;
+
+		HelperAmp() {};
 		bool HasAccelerator() const { return accelerator::get_all().size() > 0; };
 		bool HasHWAccelerator() const;
 
@@ -33,14 +38,14 @@ namespace mns
 		virtual VectorT GetResidualImpl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const override;
 		virtual T GetVectorNorm2Impl(int n, const VectorT& v) const override;
 
-		Helper1(const Helper1&);
-		Helper1& operator =(const Helper1&);
-		Helper1& operator =(Helper1&&);
+		HelperAmp(const HelperAmp&);
+		HelperAmp& operator =(const HelperAmp&);
+		HelperAmp& operator =(HelperAmp&&);
 	};
 
 
 	template<typename T> 
-	bool Helper1<T>::HasHWAccelerator() const
+	bool HelperAmp<T>::HasHWAccelerator() const
 	{
 		bool res = false;
 
@@ -60,19 +65,23 @@ namespace mns
 // bool can_use_doubles_with_limits = accelerator().supports_limited_double_precision;
 
 	template<typename T> 
-	T Helper1<T>::GetVectorNorm2Impl(int n, const VectorT& v) const
+	T HelperAmp<T>::GetVectorNorm2Impl(int n, const VectorT& v) const
 	{
-		array_view<const T, 1> a(n, v);
-		T s = 0.0;
-
-		return std::sqrt(s);
+	// The norm is computed on the host until an accelerator kernel is written
+		MNS_PROBE(Norm);
+		return ( n > 0 ) ? Reduction<T>::Norm2(&v[0], n, this->GetAccumulation()) : T(0.0);
 	}
 
 	template<typename T> 
-	typename Helper1<T>::VectorT Helper1<T>::GetResidualImpl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const
+	typename HelperAmp<T>::VectorT HelperAmp<T>::GetResidualImpl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const
 	{
+	// The residual is computed on the host by SpMv<T> until an accelerator kernel is written
+		MNS_PROBE(Residual);
 		VectorT r(n);
-		
+		if( n > 0 )
+		{
+			SpMv<T>::Residual(n, &a[0], &x[0], &b[0], &r[0]);
+		}
 		return r;
 	}
 
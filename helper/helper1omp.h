@@ -10,11 +10,14 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #ifndef __HELPER1OMP_H__
 #define __HELPER1OMP_H__
 
+#include <algorithm>
 #include <cmath>
 #include <functional>
 #include <numeric>
 #include <omp.h>
 #include "ihelper.h"
+#include "spmv.h"
+#include "../service/probe.h"
 
 namespace mns 
 {
@@ -22,16 +25,28 @@ namespace mns
 	class HelperOmp final : public IHelper<T>
 	{
 	// Implements common vector/matrix operations
+	// The parallel regions take GetNumThreads() threads by their num_threads clause, the global OpenMP settings
+	// (omp_set_num_threads) are not changed, so that several helpers may use different numbers of threads
+	// The sums are not reduced by reduction(+), whose order depends on the threads: the residual and the norm are
+	// SpMv<T>::MultiplyParallel and Reduction<T>::Norm2Parallel run by the parallel loop, the results are the ones of HelperPool
 	public:
-		HelperOmp() {};
+		typedef typename IHelper<T>::VectorT VectorT;
+		typedef typename IHelper<T>::SpdMatrixT SpdMatrixT;
 
-		int  GetNumThreads() const;
-		void SetNumThreads(int n) const;
+		explicit HelperOmp(int numThreads = 0) : numThreads_(1) { SetNumThreads(numThreads); };
+
+		int  GetNumThreads() const { return numThreads_; };
+		void SetNumThreads(int n);
 		int  GetNumProcs() const;
 
 	private:
 		virtual VectorT GetResidualImpl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const override;
+		virtual void GetResidualImpl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b, VectorT& r) const override;
+		virtual T GetResidualNorm2Impl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const override;
 		virtual T GetVectorNorm2Impl(int n, const VectorT& v) const override;
+		void ForEach(int count, const std::function<void(int)>& body) const;
+
+		int numThreads_;
 
 		HelperOmp(const HelperOmp&);
 		HelperOmp& operator =(const HelperOmp&);
@@ -39,9 +54,10 @@ namespace mns
 	};
 
 	template<typename T> 
-	void HelperOmp<T>::SetNumThreads(int n) const
+	void HelperOmp<T>::SetNumThreads(int n)
 	{
-		omp_set_num_threads(n);
+	// n <= 0 means the default number of threads of OpenMP
+		numThreads_ = ( n > 0 ) ? n : omp_get_max_threads();
 	}
 
 	template<typename T> 
@@ -51,24 +67,25 @@ namespace mns
 	}
 
 	template<typename T> 
-	int HelperOmp<T>::GetNumThreads() const
+	void HelperOmp<T>::ForEach(int count, const std::function<void(int)>& body) const
 	{
-		return omp_get_num_threads();
+	// Calls body(t) for t in [0, count) by a parallel loop, the loop of SpMv<T> and Reduction<T>
+		#pragma omp parallel for schedule(dynamic, 1) num_threads(numThreads_) if( count > 1 )
+		for( int t = 0; t < count; ++t )
+		{
+			body(t);
+		}
 	}
 
 	template<typename T> 
 	T HelperOmp<T>::GetVectorNorm2Impl(int n, const VectorT& v) const
 	{
-		T s = T(0.0);
-		int i;
-
-		#pragma omp parallel for reduction(+: s)
-		for ( i = 0; i < n; ++i ) 
+		MNS_PROBE(Norm);
+		if( n <= 0 )
 		{
-			s += v[i] * v[i];
+			return T(0.0);
 		}
-
-		return std::sqrt(s);
+		return Reduction<T>::Norm2Parallel(&v[0], n, this->GetAccumulation(), [this](int count, const std::function<void(int)>& body) { ForEach(count, body); });
 	}
 
 /*
@@ -86,26 +103,33 @@ namespace mns
 	template<typename T> 
 	typename HelperOmp<T>::VectorT HelperOmp<T>::GetResidualImpl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const
 	{
-		VectorT r(n);
-		int j;
+		VectorT r;
+		GetResidualImpl(n, a, x, b, r);
+		return r;
+	}
 
-		#pragma omp parallel for
-		for( int i = 0; i < n; ++i )
+	template<typename T> 
+	void HelperOmp<T>::GetResidualImpl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b, VectorT& r) const
+	{
+		MNS_PROBE(Residual);
+		r.resize(n);
+		if( n > 0 )
 		{
-			r[i] = T(0.0);
-			for( j = 0; j < i; ++j )
-			{
-				r[i] += a[j + ((Size_T)i) * (i + 1) / 2] * x[j];
-			}
-			for( j = i; j < n; ++j )
-			{
-				r[i] += a[i + ((Size_T)j) * (j + 1) / 2] * x[j];
-			}
-			r[i] = b[i] - r[i];
+			SpMv<T>::MultiplyParallel(n, &a[0], &x[0], &b[0], &r[0], this->GetArena(), [this](int count, const std::function<void(int)>& body) { ForEach(count, body); });
 		}
-		return r;
 	}
 
+	template<typename T> 
+	T HelperOmp<T>::GetResidualNorm2Impl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const
+	{
+	// The residual vector is not formed, its elements are squared as soon as they are summed
+		MNS_PROBE(Residual);
+		if( n <= 0 )
+		{
+			return T(0.0);
+		}
+		return std::sqrt(SpMv<T>::MultiplyParallel(n, &a[0], &x[0], &b[0], nullptr, this->GetArena(), [this](int count, const std::function<void(int)>& body) { ForEach(count, body); }));
+	}
 
 } // end of MNS namespace
 
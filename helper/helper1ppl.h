@@ -10,62 +10,82 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #ifndef __HELPER1PPL_H__
 #define __HELPER1PPL_H__
 
+#include <algorithm>
 #include <cmath>
 #include <functional>
 #include <numeric>
 #include <ppl.h>
 #include "ihelper.h"
+#include "spmv.h"
+#include "../service/probe.h"
 
 using namespace concurrency;
 
 namespace mns 
 {
 	template <typename T>
-	class Helper1 final : public IHelper<T>
+	class HelperPpl final : public IHelper<T>
 	{
 	// Implements common vector/matrix operations
 	public:
-		Helper1() {};
+		typedef typename IHelper<T>::VectorT VectorT;
+		typedef typename IHelper<T>::SpdMatrixT SpdMatrixT;
+
+		HelperPpl() {};
 	private:
 		virtual VectorT GetResidualImpl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const override;
+		virtual void GetResidualImpl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b, VectorT& r) const override;
+		virtual T GetResidualNorm2Impl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const override;
 		virtual T GetVectorNorm2Impl(int n, const VectorT& v) const override;
+		static void ForEach(int count, const std::function<void(int)>& body) { parallel_for(0, count, body); }; // the loop of SpMv<T> and Reduction<T>
 
-		Helper1(const Helper1&);
-		Helper1& operator =(const Helper1&);
-		Helper1& operator =(Helper1&&);
+		HelperPpl(const HelperPpl&);
+		HelperPpl& operator =(const HelperPpl&);
+		HelperPpl& operator =(HelperPpl&&);
 	};
 
 	template<typename T> 
-	T Helper1<T>::GetVectorNorm2Impl(int n, const VectorT& v) const
+	T HelperPpl<T>::GetVectorNorm2Impl(int n, const VectorT& v) const
 	{
-		T s = T(0.0);
-		parallel_for(0, n, [&](int i)
+	// Every chunk writes its own partial sum, they are combined in the fixed order of Reduction<T>::Combine
+		MNS_PROBE(Norm);
+		if( n <= 0 )
 		{
-			s += v[i] * v[i];
-		});
-		return std::sqrt(s);
+			return T(0.0);
+		}
+		return Reduction<T>::Norm2Parallel(&v[0], n, this->GetAccumulation(), &HelperPpl<T>::ForEach);
 	}
 
 	template<typename T> 
-	typename Helper1<T>::VectorT Helper1<T>::GetResidualImpl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const
+	typename HelperPpl<T>::VectorT HelperPpl<T>::GetResidualImpl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const
 	{
-		VectorT r(n);
-		parallel_for(0, n, [&](int i)
-		{
-			r[i] = 0.0;
-			for( int j = 0; j < i; ++j )
-			{
-				r[i] += a[j + ((Size_T)i) * (i + 1) / 2] * x[j];
-			}
-			for( int j = i; j < n; ++j )
-			{
-				r[i] += a[i + ((Size_T)j) * (j + 1) / 2] * x[j];
-			}
-			r[i] = b[i] - r[i];
-		});
+		VectorT r;
+		GetResidualImpl(n, a, x, b, r);
 		return r;
 	}
 
+	template<typename T> 
+	void HelperPpl<T>::GetResidualImpl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b, VectorT& r) const
+	{
+		MNS_PROBE(Residual);
+		r.resize(n);
+		if( n > 0 )
+		{
+			SpMv<T>::MultiplyParallel(n, &a[0], &x[0], &b[0], &r[0], this->GetArena(), &HelperPpl<T>::ForEach);
+		}
+	}
+
+	template<typename T> 
+	T HelperPpl<T>::GetResidualNorm2Impl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const
+	{
+	// The residual vector is not formed, its elements are squared as soon as they are summed
+		MNS_PROBE(Residual);
+		if( n <= 0 )
+		{
+			return T(0.0);
+		}
+		return std::sqrt(SpMv<T>::MultiplyParallel(n, &a[0], &x[0], &b[0], nullptr, this->GetArena(), &HelperPpl<T>::ForEach));
+	}
 
 } // end of mns namespace
 
@@ -0,0 +1,138 @@
+/* 
+*************************************************************
+Copyright  2013 Igor Kohanovsky e-mail: Igor.Kohanovsky@gmail.com
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*************************************************************
+*/
+#pragma once
+#ifndef __HELPERPOOL_H__
+#define __HELPERPOOL_H__
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include "ihelper.h"
+#include "spmv.h"
+#include "../common/simd.h"
+#include "../service/probe.h"
+#include "../service/threadpool.h"
+
+namespace mns
+{
+	template <typename T>
+	class HelperPool final : public IHelper<T>
+	{
+	// Implements common vector/matrix operations on the persistent ThreadPool, it needs the standard library only
+	// The residual is SpMv<T>::MultiplyParallel and the norm is Reduction<T>::Norm2Parallel run by the loop of the pool,
+	// so the results do not depend on the number of threads or the scheduling and are the ones of HelperOmp;
+	// the norms of vectors are the ones of Helper1.
+	public:
+		typedef typename IHelper<T>::VectorT VectorT;
+		typedef typename IHelper<T>::SpdMatrixT SpdMatrixT;
+
+		explicit HelperPool(int numThreads = 0) : numThreads_(1) { SetNumThreads(numThreads); };
+
+		int  GetNumThreads() const { return numThreads_; };
+		void SetNumThreads(int numThreads);
+
+	private:
+		virtual VectorT GetResidualImpl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const override;
+		virtual void GetResidualImpl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b, VectorT& r) const override;
+		virtual T GetResidualNorm2Impl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const override;
+		virtual T GetVectorNorm2Impl(int n, const VectorT& v) const override;
+		void ForEach(int count, const std::function<void(int)>& body) const;
+
+		int numThreads_;
+		std::unique_ptr<ThreadPool> pool_; // nullptr for numThreads_ == 1
+
+		HelperPool(const HelperPool&);
+		HelperPool& operator =(const HelperPool&);
+		HelperPool& operator =(HelperPool&&);
+	};
+
+	template<typename T>
+	void HelperPool<T>::SetNumThreads(int numThreads)
+	{
+	// Sets the number of threads, numThreads <= 0 means the number of processors
+		if( numThreads <= 0 )
+		{
+			numThreads = ThreadPool::GetNumProcs();
+		}
+		if( numThreads == numThreads_ )
+		{
+			return;
+		}
+
+		numThreads_ = numThreads;
+		pool_.reset(( numThreads > 1 ) ? new ThreadPool(numThreads) : nullptr);
+	}
+
+	template<typename T>
+	void HelperPool<T>::ForEach(int count, const std::function<void(int)>& body) const
+	{
+	// Calls body(t) for t in [0, count) on the pool, the loop of SpMv<T> and Reduction<T>
+		if( pool_ == nullptr || count <= 1 )
+		{
+			for( int t = 0; t < count; ++t )
+			{
+				body(t);
+			}
+			return;
+		}
+		pool_->ParallelFor(0, count, 1, [&](int lo, int hi)
+		{
+			for( int t = lo; t < hi; ++t )
+			{
+				body(t);
+			}
+		});
+	}
+
+	template<typename T>
+	T HelperPool<T>::GetVectorNorm2Impl(int n, const VectorT& v) const
+	{
+		MNS_PROBE(Norm);
+		if( n <= 0 )
+		{
+			return T(0.0);
+		}
+		return Reduction<T>::Norm2Parallel(&v[0], n, this->GetAccumulation(), [this](int count, const std::function<void(int)>& body) { ForEach(count, body); });
+	}
+
+	template<typename T>
+	typename HelperPool<T>::VectorT HelperPool<T>::GetResidualImpl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const
+	{
+		VectorT r;
+		GetResidualImpl(n, a, x, b, r);
+		return r;
+	}
+
+	template<typename T>
+	void HelperPool<T>::GetResidualImpl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b, VectorT& r) const
+	{
+		MNS_PROBE(Residual);
+		r.resize(n);
+		if( n > 0 )
+		{
+			SpMv<T>::MultiplyParallel(n, &a[0], &x[0], &b[0], &r[0], this->GetArena(), [this](int count, const std::function<void(int)>& body) { ForEach(count, body); });
+		}
+	}
+
+	template<typename T>
+	T HelperPool<T>::GetResidualNorm2Impl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const
+	{
+	// The residual vector is not formed, its elements are squared as soon as they are summed
+		MNS_PROBE(Residual);
+		if( n <= 0 )
+		{
+			return T(0.0);
+		}
+		return std::sqrt(SpMv<T>::MultiplyParallel(n, &a[0], &x[0], &b[0], nullptr, this->GetArena(), [this](int count, const std::function<void(int)>& body) { ForEach(count, body); }));
+	}
+
+} // end of mns namespace
+
+#endif // __HELPERPOOL_H__
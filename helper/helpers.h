@@ -0,0 +1,135 @@
+/* 
+*************************************************************
+Copyright  2013 Igor Kohanovsky e-mail: Igor.Kohanovsky@gmail.com
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*************************************************************
+*/
+#pragma once
+#ifndef __HELPERS_H__
+#define __HELPERS_H__
+
+#include <memory>
+#include <string>
+#include "ihelper.h"
+#include "helper1.h"
+#include "helperpool.h"
+
+// The backends which need compiler support are compiled in when the compiler provides it:
+// OpenMP when it is enabled (/openmp, -fopenmp), PPL with Visual C++, C++ AMP with Visual C++ 2012 - 2019
+#if defined(_OPENMP)
+#define MNS_HELPER_OMP
+#include "helper1omp.h"
+#endif
+#if defined(_MSC_VER)
+#define MNS_HELPER_PPL
+#include "helper1ppl.h"
+#if _MSC_VER >= 1700 && _MSC_VER < 1930
+#define MNS_HELPER_AMP
+#include "helper1amp.h"
+#endif
+#endif
+
+namespace mns
+{
+	// Implementations of IHelper
+	enum class HelperKind : unsigned int
+	{
+		Serial = 0x0, // Helper1
+		Pool = 0x1,   // HelperPool, std::thread
+		Omp = 0x2,    // HelperOmp, OpenMP
+		Ppl = 0x3,    // HelperPpl, Parallel Patterns Library
+		Amp = 0x4,    // HelperAmp, C++ AMP
+		Count = 0x5
+	};
+
+	template <typename T>
+	class Helpers final
+	{
+	// Creates the helpers by their kind (or name) at run time, the kinds which are not compiled in are not available
+	public:
+		static std::unique_ptr<IHelper<T>> Create(HelperKind kind, int numThreads = 0); // nullptr if kind is not available
+		static bool IsAvailable(HelperKind kind);
+		static const char* GetName(HelperKind kind);
+		static bool GetKind(const std::string& name, HelperKind& kind);
+	private:
+		Helpers();
+	};
+
+	template<typename T>
+	std::unique_ptr<IHelper<T>> Helpers<T>::Create(HelperKind kind, int numThreads)
+	{
+	// numThreads is used by HelperPool and HelperOmp, <= 0 means their default; PPL and AMP keep their own settings
+		switch( kind )
+		{
+		case HelperKind::Serial:
+			return std::unique_ptr<IHelper<T>>(new Helper1<T>());
+		case HelperKind::Pool:
+			return std::unique_ptr<IHelper<T>>(new HelperPool<T>(numThreads));
+#ifdef MNS_HELPER_OMP
+		case HelperKind::Omp:
+			return std::unique_ptr<IHelper<T>>(new HelperOmp<T>(numThreads));
+#endif
+#ifdef MNS_HELPER_PPL
+		case HelperKind::Ppl:
+			return std::unique_ptr<IHelper<T>>(new HelperPpl<T>());
+#endif
+#ifdef MNS_HELPER_AMP
+		case HelperKind::Amp:
+			return std::unique_ptr<IHelper<T>>(new HelperAmp<T>());
+#endif
+		default:
+			return std::unique_ptr<IHelper<T>>();
+		}
+	}
+
+	template<typename T>
+	bool Helpers<T>::IsAvailable(HelperKind kind)
+	{
+		switch( kind )
+		{
+		case HelperKind::Serial:
+		case HelperKind::Pool:
+			return true;
+#ifdef MNS_HELPER_OMP
+		case HelperKind::Omp:
+			return true;
+#endif
+#ifdef MNS_HELPER_PPL
+		case HelperKind::Ppl:
+			return true;
+#endif
+#ifdef MNS_HELPER_AMP
+		case HelperKind::Amp:
+			return true;
+#endif
+		default:
+			return false;
+		}
+	}
+
+	template<typename T>
+	const char* Helpers<T>::GetName(HelperKind kind)
+	{
+		static const char* names[] = { "serial", "pool", "omp", "ppl", "amp" };
+		return ( kind < HelperKind::Count ) ? names[(int)kind] : "";
+	}
+
+	template<typename T>
+	bool Helpers<T>::GetKind(const std::string& name, HelperKind& kind)
+	{
+		for( int k = 0; k < (int)HelperKind::Count; ++k )
+		{
+			if( name == GetName((HelperKind)k) )
+			{
+				kind = (HelperKind)k;
+				return true;
+			}
+		}
+		return false;
+	}
+
+} // end of mns namespace
+
+#endif // __HELPERS_H__
@@ -11,7 +11,9 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #define __IHelper_H__
 
 #include <cmath>
+#include "../common/arena.h"
 #include "../common/defs.h"
+#include "../common/reduction.h"
 
 namespace mns 
 {
@@ -21,6 +23,9 @@ namespace mns
 	class IHelper
 	{
 	// Defines interface for common vector/matrix operations
+	// Scratch buffers of the implementations are taken from an arena (own one or the one given to SetArena()), so the
+	// repeated operations do not allocate heap memory. Hence a helper must not be used by several threads at once,
+	// even by its const methods; the objects which run at the same time need helpers (or arenas) of their own.
 	public:
 		typedef typename Defs<T>::VectorT VectorT;
 		typedef typename Defs<T>::SpdMatrixT SpdMatrixT;
@@ -29,24 +34,51 @@ namespace mns
 		inline T SQRTPI() const { return std::sqrt(PI()); }
 
 		VectorT GetResidual(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const { return GetResidualImpl(n, a, x, b); };
+		void    GetResidual(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b, VectorT& r) const { GetResidualImpl(n, a, x, b, r); }; // r = b - A * x, r is resized to n
+		T       GetResidualNorm2(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const { return GetResidualNorm2Impl(n, a, x, b); }; // ||b - A * x||_2
 		T		GetVectorNorm2(int n, const VectorT& v) const { return GetVectorNorm2Impl(n, v); }
 
 		T		GetGamma2(int n) const { return GetGamma2Impl(n); }
 
+		// Scratch buffers of the implementations are taken from the arena, nullptr means the own arena
+		Arena&  GetArena() const { return *arena_; };
+		void    SetArena(Arena* arena) { arena_ = ( arena != nullptr ) ? arena : &ownArena_; };
+
+		// Accumulation of the sums of GetVectorNorm2 (see Reduction<T>), the default is Accumulation::Pairwise
+		Accumulation GetAccumulation() const { return accumulation_; };
+		void    SetAccumulation(Accumulation accumulation) { accumulation_ = accumulation; };
+
 		virtual ~IHelper() {};
 	protected:
-		virtual VectorT GetResidualImpl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const abstract; 
-		virtual T GetVectorNorm2Impl(int n, const VectorT& v) const abstract;
+		virtual VectorT GetResidualImpl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const = 0; 
+		virtual void GetResidualImpl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b, VectorT& r) const { r = GetResidualImpl(n, a, x, b); };
+		virtual T GetResidualNorm2Impl(int n, const SpdMatrixT& a, const VectorT& x, const VectorT& b) const { return GetVectorNorm2Impl(n, GetResidualImpl(n, a, x, b)); };
+		virtual T GetVectorNorm2Impl(int n, const VectorT& v) const = 0;
 
-		virtual T GetGamma2Impl(int n) const abstract;
+		virtual T GetGamma2Impl(int n) const;
 
-		IHelper() {};
+		IHelper() : arena_(&ownArena_), accumulation_(Accumulation::Pairwise) {};
 	private:
+		mutable Arena ownArena_;
+		Arena* arena_;
+		Accumulation accumulation_;
+
     	IHelper(const IHelper&);
 		IHelper& operator =(const IHelper&);
 		IHelper& operator =(IHelper&&);
 	};
 
+	template<typename T> 
+	T IHelper<T>::GetGamma2Impl(int n) const
+	{
+		T s = T(1.0);
+		for( int i = 1; i <= n; ++i )
+		{
+			s *= ((T(2.0)*i - 1)/2.0);
+		}
+		return s*SQRTPI();
+	}
+
 } // end of mns namespace
 
 #endif // __IHelper_H__
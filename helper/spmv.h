@@ -0,0 +1,188 @@
+/* 
+*************************************************************
+Copyright  2013 Igor Kohanovsky e-mail: Igor.Kohanovsky@gmail.com
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*************************************************************
+*/
+#pragma once
+#ifndef __SPMV_H__
+#define __SPMV_H__
+
+#include <algorithm>
+#include <cmath>
+#include "../common/arena.h"
+#include "../common/defs.h"
+#include "../common/reduction.h"
+#include "../common/simd.h"
+
+// The number of parts of the threaded products, the upper bound of their parallelism. It is fixed at compile time,
+// since the sums of the parts, and so the rounding of the results, depend on it.
+#ifndef MNS_SPMV_PARTS
+#define MNS_SPMV_PARTS 64
+#endif
+
+namespace mns
+{
+	template <typename T>
+	class SpMv
+	{
+	// Products of a symmetric matrix kept as the row-packed lower triangle by a vector
+	// The triangle is read once, row by row: row i gives y[i] += a(i, 0:i) * x(0:i) (a dot product) and,
+	// by symmetry, y(0:i) += x[i] * a(i, 0:i) (a scatter), both are contiguous vector operations.
+	//
+	// Threaded version: the rows are split into parts of equal work (GetPartition), every part is multiplied into
+	// its own accumulator (MultiplyRows), then the accumulators are summed by chunks of [0, n) (Reduce).
+	// MultiplyParallel() runs the phases by the loop of the caller's parallel backend, forEach(count, body) calls
+	// body(t) for t in [0, count); the result does not depend on the thread count for a given number of parts,
+	// the callers use GetNumParts(n) parts whatever the number of their threads.
+	public:
+		static const int Parts = MNS_SPMV_PARTS;
+		static const int MinPartSize = 16384; // elements of the triangle, the smaller matrices are split into fewer parts
+
+		static int  GetNumParts(int n) { return (int)std::max<Size_T>(1, std::min<Size_T>(Parts, ((Size_T)n) * (n + 1) / 2 / MinPartSize)); };
+
+		static void Multiply(int n, const T* a, const T* x, T* y);
+		static void Residual(int n, const T* a, const T* x, const T* b, T* r);
+		static T    ResidualNorm2(int n, const T* a, const T* x, const T* b, T* scratch);
+
+		template <typename ForEach>
+		static T    MultiplyParallel(int n, const T* a, const T* x, const T* b, T* r, Arena& arena, ForEach forEach);
+
+		static void GetPartition(int n, int parts, int* bounds);
+		static void MultiplyRows(const T* a, const T* x, int ib, int ie, T* acc);
+		static T    Reduce(int parts, const int* bounds, const T* const* acc, int jb, int je, const T* b, T* r);
+	private:
+		SpMv();
+	};
+
+	template<typename T>
+	void SpMv<T>::Multiply(int n, const T* a, const T* x, T* y)
+	{
+	// y = A * x
+		std::fill(y, y + n, T(0.0));
+		MultiplyRows(a, x, 0, n, y);
+	}
+
+	template<typename T>
+	void SpMv<T>::Residual(int n, const T* a, const T* x, const T* b, T* r)
+	{
+	// r = b - A * x
+		std::copy(b, b + n, r);
+		for( int i = 0; i < n; ++i )
+		{
+			const T* ai = a + ((Size_T)i) * (i + 1) / 2;
+			r[i] -= Simd<T>::Dot(ai, x, i + 1);
+			Simd<T>::Axpy(-x[i], ai, r, i);
+		}
+	}
+
+	template<typename T>
+	T SpMv<T>::ResidualNorm2(int n, const T* a, const T* x, const T* b, T* scratch)
+	{
+	// Returns ||b - A * x||_2, scratch is n elements long
+	// The rows are traversed from the last one: r[i] is complete once row i is processed, since the rows below it
+	// have already scattered their contributions into it, so it is squared and summed at once
+		std::copy(b, b + n, scratch);
+		T s = T(0.0);
+		for( int i = n - 1; i >= 0; --i )
+		{
+			const T* ai = a + ((Size_T)i) * (i + 1) / 2;
+			scratch[i] -= Simd<T>::Dot(ai, x, i + 1);
+			Simd<T>::Axpy(-x[i], ai, scratch, i);
+			s += scratch[i] * scratch[i];
+		}
+		return std::sqrt(s);
+	}
+
+	template<typename T>
+	template <typename ForEach>
+	T SpMv<T>::MultiplyParallel(int n, const T* a, const T* x, const T* b, T* r, Arena& arena, ForEach forEach)
+	{
+	// Computes r = b - A * x (r = A * x if b is nullptr, r may be nullptr) by GetNumParts(n) parts and returns ||r||^2
+	// Every part of the rows is multiplied into its own accumulator taken from the arena, then the accumulators
+	// are summed by the chunks of Reduction<T>, whose sums of squares are added by Reduction<T>::Combine
+		typedef typename Reduction<T>::Partial Partial;
+		ArenaScope scope(arena);
+		const int parts = GetNumParts(n);
+		int* bounds = arena.Allocate<int>(parts + 1);
+		T** acc = arena.Allocate<T*>(parts);
+		GetPartition(n, parts, bounds);
+		for( int t = 0; t < parts; ++t )
+		{
+			acc[t] = arena.Allocate<T>(bounds[t + 1]);
+		}
+
+		forEach(parts, [&](int t)
+		{
+			std::fill(acc[t], acc[t] + bounds[t + 1], T(0.0));
+			MultiplyRows(a, x, bounds[t], bounds[t + 1], acc[t]);
+		});
+
+		const int chunk = Reduction<T>::Chunk;
+		int chunks = Reduction<T>::GetNumChunks(n);
+		Partial* sums = arena.Allocate<Partial>(chunks);
+		forEach(chunks, [&](int c)
+		{
+			sums[c] = Reduction<T>::ToPartial(Reduce(parts, bounds, acc, c * chunk, std::min(n, (c + 1) * chunk), b, r));
+		});
+		return Reduction<T>::Combine(sums, chunks, Accumulation::Pairwise);
+	}
+
+	template<typename T>
+	void SpMv<T>::GetPartition(int n, int parts, int* bounds)
+	{
+	// Splits the rows into parts [bounds[t], bounds[t + 1]) of about the same number of elements
+	// The rows [0, m) hold m(m+1)/2 elements, so bounds[t] = n * sqrt(t / parts)
+		bounds[0] = 0;
+		for( int t = 1; t < parts; ++t )
+		{
+			int b = (int)(n * std::sqrt((double)t / parts) + 0.5);
+			bounds[t] = std::min(n, std::max(bounds[t - 1], b));
+		}
+		bounds[parts] = n;
+	}
+
+	template<typename T>
+	void SpMv<T>::MultiplyRows(const T* a, const T* x, int ib, int ie, T* acc)
+	{
+	// acc(0:ie) += A(ib:ie, :) * x restricted to the lower triangle rows [ib, ie) and their symmetric counterparts
+		for( int i = ib; i < ie; ++i )
+		{
+			const T* ai = a + ((Size_T)i) * (i + 1) / 2;
+			acc[i] += Simd<T>::Dot(ai, x, i + 1);
+			Simd<T>::Axpy(x[i], ai, acc, i);
+		}
+	}
+
+	template<typename T>
+	T SpMv<T>::Reduce(int parts, const int* bounds, const T* const* acc, int jb, int je, const T* b, T* r)
+	{
+	// Sums the accumulators of the parts for [jb, je): y = sum of acc[t], r = b - y if b is given or r = y otherwise
+	// The accumulator of part t holds bounds[t + 1] elements. Returns the sum of squares of r(jb:je).
+	// r may be nullptr, then only the sum of squares is computed.
+		T s = T(0.0);
+		for( int j = jb; j < je; ++j )
+		{
+			T y = T(0.0);
+			for( int t = 0; t < parts; ++t )
+			{
+				if( j < bounds[t + 1] )
+				{
+					y += acc[t][j];
+				}
+			}
+			T rj = ( b != nullptr ) ? b[j] - y : y;
+			if( r != nullptr )
+			{
+				r[j] = rj;
+			}
+			s += rj * rj;
+		}
+		return s;
+	}
+
+} // end of mns namespace
+
+#endif // __SPMV_H__
@@ -0,0 +1,184 @@
+/* 
+*************************************************************
+Copyright  2013 Igor Kohanovsky e-mail: Igor.Kohanovsky@gmail.com
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*************************************************************
+*/
+#pragma once
+#ifndef __GRAM_H__
+#define __GRAM_H__
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include "irk.h"
+#include "../common/simd.h"
+#include "../service/probe.h"
+#include "../service/threadpool.h"
+
+namespace mns
+{
+	template <typename T, int Dims>
+	class Gram final
+	{
+	// Assembles the Gram matrix of the functionals defined by the nodes, the result is the packed lower triangle by rows
+	// (SpdLayout::Packed) consumed by SpdChol
+	// Row i of the triangle is computed in place: the distances from node i to the nodes 0..i are computed by the vector
+	// kernel Simd::Distance over the structure-of-arrays copy of the nodes, then the kernel is evaluated for the whole row
+	// by the batch version IRK::GetValues.
+	// The rows are split into parts of equal work (a triangle) and the parts are assembled on numThreads threads.
+	public:
+		typedef typename Defs<T, Dims>::VectorT VectorT;
+		typedef typename Defs<T, Dims>::SpdMatrixT SpdMatrixT;
+		typedef typename Defs<T, Dims>::VectorP VectorP;
+
+		// Functionals of the nodes, Value is f(x_i) (interpolation)
+		enum class Functional : unsigned int
+		{
+			Value = 0x0
+		};
+
+		explicit Gram(const IRK<T>& rk, Functional functional = Functional::Value) : rk_(rk), functional_(functional), numThreads_(1) {};
+
+		Status Assemble(const VectorP& nodes, SpdMatrixT& a);
+		Status AssembleRows(const VectorP& nodes, int ib, int ie, T* a);
+
+		int  GetNumThreads() const { return numThreads_; };
+		void SetNumThreads(int numThreads);
+
+		static void ToSoA(const VectorP& nodes, int n, T* soa);
+		static void GetPartition(int ib, int ie, int parts, int* bounds);
+
+		static const int PartsPerThread = 4; // more parts than threads balance the rows of unequal cost
+	private:
+		void AssembleRow(const T* soa, int n, int i, T* row) const;
+
+		const IRK<T>& rk_;
+		Functional functional_;
+		int numThreads_;
+		std::unique_ptr<ThreadPool> pool_; // nullptr for numThreads_ == 1
+		VectorT soa_;                      // coordinate k of node j is soa_[k * n + j]
+
+		Gram(const Gram&);
+		Gram& operator =(const Gram&);
+	};
+
+	template<typename T, int Dims>
+	void Gram<T, Dims>::SetNumThreads(int numThreads)
+	{
+	// Sets the number of threads of the assembly, numThreads <= 0 means the number of processors
+		if( numThreads <= 0 )
+		{
+			numThreads = ThreadPool::GetNumProcs();
+		}
+		if( numThreads == numThreads_ )
+		{
+			return;
+		}
+
+		numThreads_ = numThreads;
+		pool_.reset(( numThreads > 1 ) ? new ThreadPool(numThreads) : nullptr);
+	}
+
+	template<typename T, int Dims>
+	void Gram<T, Dims>::ToSoA(const VectorP& nodes, int n, T* soa)
+	{
+	// Copies the first n nodes to the structure-of-arrays layout, coordinate k of node j goes to soa[k * n + j]
+		for( int j = 0; j < n; ++j )
+		{
+			for( int k = 0; k < Dims; ++k )
+			{
+				soa[((Size_T)k) * n + j] = nodes[j].p[k];
+			}
+		}
+	}
+
+	template<typename T, int Dims>
+	void Gram<T, Dims>::GetPartition(int ib, int ie, int parts, int* bounds)
+	{
+	// Splits the rows [ib, ie) into parts [bounds[t], bounds[t + 1]) of about the same number of elements
+	// The rows [ib, m) hold about (m^2 - ib^2) / 2 elements, so bounds[t] = sqrt(ib^2 + (ie^2 - ib^2) * t / parts)
+		double b2 = ((double)ib) * ib;
+		double e2 = ((double)ie) * ie;
+		bounds[0] = ib;
+		for( int t = 1; t < parts; ++t )
+		{
+			int b = (int)(std::sqrt(b2 + (e2 - b2) * t / parts) + 0.5);
+			bounds[t] = std::min(ie, std::max(bounds[t - 1], b));
+		}
+		bounds[parts] = ie;
+	}
+
+	template<typename T, int Dims>
+	Status Gram<T, Dims>::Assemble(const VectorP& nodes, SpdMatrixT& a)
+	{
+	// a = the packed lower triangle of the Gram matrix of all the nodes
+		int n = (int)nodes.size();
+		a.resize(((Size_T)n) * (n + 1) / 2);
+		return AssembleRows(nodes, 0, n, a.data());
+	}
+
+	template<typename T, int Dims>
+	Status Gram<T, Dims>::AssembleRows(const VectorP& nodes, int ib, int ie, T* a)
+	{
+	// Assembles the rows [ib, ie) of the packed lower triangle, a points to row ib (the element ib * (ib + 1) / 2 of the triangle)
+	// Row i is the column i of the Gram matrix restricted to the nodes 0..i, so the rows appended to a factorized matrix
+	// are the columns expected by SpdChol::UpdateAdd
+		MNS_PROBE(Assemble);
+		if( ib < 0 || ie < ib || ie > (int)nodes.size() )
+		{
+			return Status::BadParameter;
+		}
+		if( functional_ != Functional::Value )
+		{
+			return Status::BadParameter;
+		}
+
+		soa_.resize(((Size_T)Dims) * ie);
+		ToSoA(nodes, ie, soa_.data());
+		const T* soa = soa_.data();
+		Size_T base = ((Size_T)ib) * (ib + 1) / 2;
+
+		int numParts = ( pool_ != nullptr ) ? std::min(ie - ib, PartsPerThread * pool_->GetNumThreads()) : 1;
+		if( numParts <= 1 )
+		{
+			for( int i = ib; i < ie; ++i )
+			{
+				AssembleRow(soa, ie, i, a + ((Size_T)i) * (i + 1) / 2 - base);
+			}
+			return Status::Success;
+		}
+
+		std::vector<int> bounds(numParts + 1);
+		GetPartition(ib, ie, numParts, bounds.data());
+		pool_->ParallelFor(0, numParts, 1, [&](int lo, int hi)
+		{
+			for( int t = lo; t < hi; ++t )
+			{
+				for( int i = bounds[t]; i < bounds[t + 1]; ++i )
+				{
+					AssembleRow(soa, ie, i, a + ((Size_T)i) * (i + 1) / 2 - base);
+				}
+			}
+		});
+		return Status::Success;
+	}
+
+	template<typename T, int Dims>
+	void Gram<T, Dims>::AssembleRow(const T* soa, int n, int i, T* row) const
+	{
+	// row[j] = V(x_i, x_j), j = 0..i, soa holds n nodes
+		T xi[Dims];
+		for( int k = 0; k < Dims; ++k )
+		{
+			xi[k] = soa[((Size_T)k) * n + i];
+		}
+		Simd<T>::Distance(soa, n, Dims, xi, row, i + 1);
+		rk_.GetValues(row, row, i + 1);
+	}
+
+} // end of mns namespace
+
+#endif // __GRAM_H__
@@ -0,0 +1,580 @@
+/* 
+*************************************************************
+Copyright  2013 Igor Kohanovsky e-mail: Igor.Kohanovsky@gmail.com
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*************************************************************
+*/
+#pragma once
+#ifndef __HMATRIX_H__
+#define __HMATRIX_H__
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+#include "irk.h"
+#include "gram.h"
+#include "../common/arena.h"
+#include "../common/kdtree.h"
+#include "../common/simd.h"
+#include "../common/reduction.h"
+#include "../service/threadpool.h"
+
+namespace mns
+{
+	template <typename T, int Dims>
+	class HMatrix final
+	{
+	// Hierarchical matrix representation of the Gram matrix G(i,j) = V(x_i, x_j) of the reproducing kernel
+	// The nodes are ordered by a k-d tree (the cluster tree). The lower triangle of the matrix is split into blocks of
+	// pairs of clusters: the admissible pairs, min(diam(s), diam(t)) <= eta * dist(s, t), are kept in the low-rank form
+	// U * V^T built by adaptive cross approximation (ACA) from the rows and columns of the kernel, the pairs of leaves
+	// are kept dense, the pairs farther than the distance where the kernel drops below tol * V(0) are dropped.
+	// The memory is about O(n * log(n) * rank) instead of n(n+1)/2 of the packed matrix.
+	// A block (s,t), s != t, stands for itself and its transpose (t,s) in the products.
+	//
+	// The blocks are built and multiplied on numThreads threads, see SetNumThreads(). Multiply() splits the blocks into
+	// Parts parts whatever the number of threads, accumulates every part over the rows it touches in its own buffer and
+	// sums the buffers in a fixed order, so the result does not depend on the number of threads or the scheduling.
+	// The scratch of the products is taken from an arena (own one or the one given to SetArena()), so the repeated
+	// products do not allocate heap memory. Hence an object must not be used by several threads at once, even by its
+	// const methods.
+	public:
+		typedef typename Defs<T, Dims>::VectorT VectorT;
+		typedef typename Defs<T, Dims>::VectorP VectorP;
+
+		explicit HMatrix(const IRK<T>& rk) : rk_(rk), n_(0), eta_(T(1.0)), leafSize_(KdTree<T, Dims>::DefaultLeafSize), numThreads_(1), accSize_(0), arena_(&ownArena_) {};
+
+		Status Build(const VectorP& nodes, T tol);
+
+		void   Multiply(const T* x, T* y) const; // y = G * x in the order of the nodes
+		void   GetResidual(const VectorT& x, const VectorT& b, VectorT& r) const;
+		T      GetResidualNorm2(const VectorT& x, const VectorT& b) const;
+
+		int    GetMatrixDim() const { return n_; };
+		Size_T GetMemorySize() const;          // number of elements stored in the blocks
+		int    GetMaxRank() const;
+		T      GetEta() const { return eta_; };
+		void   SetEta(T eta) { eta_ = ( eta > T(0.0) ) ? eta : T(1.0); };
+		int    GetLeafSize() const { return leafSize_; };
+		void   SetLeafSize(int leafSize) { leafSize_ = ( leafSize > 0 ) ? leafSize : KdTree<T, Dims>::DefaultLeafSize; };
+		int    GetNumThreads() const { return numThreads_; };
+		void   SetNumThreads(int numThreads);
+		Arena& GetArena() const { return *arena_; };
+		void   SetArena(Arena* arena) { arena_ = ( arena != nullptr ) ? arena : &ownArena_; }; // nullptr means the own arena
+
+		static const int Parts = 64; // parts of the blocks in Multiply(), the upper bound of its parallelism
+	private:
+		struct Block
+		{
+			int rb, rn;  // rows [rb, rb + rn) in the tree order
+			int cb, cn;  // columns
+			int rank;    // -1 for a dense block
+			VectorT a;   // dense: rn x cn by rows, low-rank: U (rn x rank) and then V (cn x rank), both by columns
+		};
+		struct Part
+		{
+			int bb, be;    // blocks [bb, be)
+			int jb, je;    // the rows and columns [jb, je) they touch, in the tree order
+			Size_T offset; // of the accumulator in the scratch of Multiply()
+		};
+
+		void Partition(int s, int t);
+		void Fill(Block& block) const;
+		bool Aca(Block& block) const;
+		void GetRow(int i, int cb, int cn, T* v) const;
+		void Apply(const Block& block, const T* x, T* y, int jb) const;
+		static T GetDiameter(const typename KdTree<T, Dims>::Node& node);
+		static T GetDistance(const typename KdTree<T, Dims>::Node& s, const typename KdTree<T, Dims>::Node& t);
+
+		const IRK<T>& rk_;
+		int n_;
+		T eta_;
+		T tol_;
+		T tiny_;   // tol * V(0), the kernel values below it are dropped
+		int leafSize_;
+		int numThreads_;
+		std::unique_ptr<ThreadPool> pool_; // nullptr for numThreads_ == 1
+		KdTree<T, Dims> tree_;
+		VectorT soa_;                      // the nodes in the tree order
+		std::vector<Block> blocks_;
+		std::vector<Part> parts_;
+		Size_T accSize_;                   // total size of the accumulators of the parts
+		mutable Arena ownArena_;
+		Arena* arena_;                     // x, y and the accumulators of the parts of Multiply(), in the tree order
+
+		HMatrix(const HMatrix&);
+		HMatrix& operator =(const HMatrix&);
+	};
+
+	template<typename T, int Dims>
+	void HMatrix<T, Dims>::SetNumThreads(int numThreads)
+	{
+	// Sets the number of threads of building and multiplication, numThreads <= 0 means the number of processors
+		if( numThreads <= 0 )
+		{
+			numThreads = ThreadPool::GetNumProcs();
+		}
+		if( numThreads == numThreads_ )
+		{
+			return;
+		}
+
+		numThreads_ = numThreads;
+		pool_.reset(( numThreads > 1 ) ? new ThreadPool(numThreads) : nullptr);
+	}
+
+	template<typename T, int Dims>
+	Status HMatrix<T, Dims>::Build(const VectorP& nodes, T tol)
+	{
+	// Builds the blocks for the relative accuracy tol
+		int n = (int)nodes.size();
+		if( n == 0 || tol <= T(0.0) )
+		{
+			return Status::BadParameter;
+		}
+		n_ = n;
+		tol_ = tol;
+		tiny_ = tol * rk_.GetValue(T(0.0));
+
+		VectorT soa(((Size_T)Dims) * n);
+		Gram<T, Dims>::ToSoA(nodes, n, soa.data());
+		tree_.Build(soa.data(), n, n, leafSize_);
+		const std::vector<int>& index = tree_.GetIndex();
+		soa_.resize(soa.size());
+		for( int k = 0; k < Dims; ++k )
+		{
+			for( int j = 0; j < n; ++j )
+			{
+				soa_[((Size_T)k) * n + j] = soa[((Size_T)k) * n + index[j]];
+			}
+		}
+
+		blocks_.clear();
+		Partition(0, 0);
+		if( pool_ != nullptr )
+		{
+			pool_->ParallelFor(0, (int)blocks_.size(), 1, [&](int lo, int hi)
+			{
+				for( int b = lo; b < hi; ++b )
+				{
+					Fill(blocks_[b]);
+				}
+			});
+		}
+		else
+		{
+			for( Size_T b = 0; b < blocks_.size(); ++b )
+			{
+				Fill(blocks_[b]);
+			}
+		}
+
+		// Parts of about the same number of stored elements, their number does not depend on the number of threads
+		int numParts = std::min((int)Parts, (int)blocks_.size());
+		Size_T total = GetMemorySize();
+		std::vector<int> bounds(1, 0);
+		Size_T sum = 0;
+		for( int b = 0; b < (int)blocks_.size() && (int)bounds.size() < numParts; ++b )
+		{
+			sum += blocks_[b].a.size();
+			if( sum * numParts >= total * bounds.size() )
+			{
+				bounds.push_back(b + 1);
+			}
+		}
+		bounds.push_back((int)blocks_.size());
+
+		// The blocks of a part are consecutive in the order of Partition(), so they touch a narrow range of the rows
+		parts_.clear();
+		accSize_ = 0;
+		for( Size_T p = 0; p + 1 < bounds.size(); ++p )
+		{
+			Part part = { bounds[p], bounds[p + 1], n, 0, accSize_ };
+			for( int b = part.bb; b < part.be; ++b )
+			{
+				const Block& block = blocks_[b];
+				part.jb = std::min(part.jb, std::min(block.rb, block.cb));
+				part.je = std::max(part.je, std::max(block.rb + block.rn, block.cb + block.cn));
+			}
+			part.je = std::max(part.je, part.jb);
+			accSize_ += part.je - part.jb;
+			parts_.push_back(part);
+		}
+		return Status::Success;
+	}
+
+	template<typename T, int Dims>
+	void HMatrix<T, Dims>::Partition(int s, int t)
+	{
+	// Adds the blocks of the pair of clusters (s, t), the rows of s do not precede the rows of t
+		typedef typename KdTree<T, Dims>::Node Node;
+		const Node& ns = tree_.GetNodes()[s];
+		const Node& nt = tree_.GetNodes()[t];
+		if( s != t )
+		{
+			T dist = GetDistance(ns, nt);
+			if( rk_.GetValue(dist) <= tiny_ )
+			{
+				return;
+			}
+			if( std::min(GetDiameter(ns), GetDiameter(nt)) <= eta_ * dist )
+			{
+				Block block = { ns.begin, ns.end - ns.begin, nt.begin, nt.end - nt.begin, 0, VectorT() };
+				blocks_.push_back(block);
+				return;
+			}
+		}
+
+		bool leafS = ns.left < 0;
+		bool leafT = nt.left < 0;
+		if( leafS && leafT )
+		{
+			Block block = { ns.begin, ns.end - ns.begin, nt.begin, nt.end - nt.begin, -1, VectorT() };
+			blocks_.push_back(block);
+		}
+		else if( s == t )
+		{
+			Partition(ns.left, ns.left);
+			Partition(ns.right, ns.left);
+			Partition(ns.right, ns.right);
+		}
+		else if( leafT || (!leafS && ns.end - ns.begin >= nt.end - nt.begin) )
+		{
+			Partition(ns.left, t);
+			Partition(ns.right, t);
+		}
+		else
+		{
+			Partition(s, nt.left);
+			Partition(s, nt.right);
+		}
+	}
+
+	template<typename T, int Dims>
+	void HMatrix<T, Dims>::GetRow(int i, int cb, int cn, T* v) const
+	{
+	// v = G(i, cb:cb+cn) in the tree order
+		T xi[Dims];
+		for( int k = 0; k < Dims; ++k )
+		{
+			xi[k] = soa_[((Size_T)k) * n_ + i];
+		}
+		Simd<T>::Distance(soa_.data() + cb, n_, Dims, xi, v, cn);
+		rk_.GetValues(v, v, cn);
+	}
+
+	template<typename T, int Dims>
+	void HMatrix<T, Dims>::Fill(Block& block) const
+	{
+	// Computes the dense block or its cross approximation, the approximation that does not save memory is replaced by the dense block
+		if( block.rank >= 0 && Aca(block) )
+		{
+			return;
+		}
+		block.rank = -1;
+		block.a.resize(((Size_T)block.rn) * block.cn);
+		for( int i = 0; i < block.rn; ++i )
+		{
+			GetRow(block.rb + i, block.cb, block.cn, block.a.data() + ((Size_T)i) * block.cn);
+		}
+	}
+
+	template<typename T, int Dims>
+	bool HMatrix<T, Dims>::Aca(Block& block) const
+	{
+	// Adaptive cross approximation with partial pivoting: the residual row of the pivot row gives v and the pivot column j,
+	// the residual column j gives u; the next pivot row is the largest element of u
+	// Stops when |u| * |v| <= tol * |U * V^T|_F or all the rows are used. A residual row below tol * V(0) does not stop it:
+	// the kernel decays across the block, so a row far from the columns vanishes while the near ones do not, the next
+	// unused row is tried instead. Returns false if the rank reaches the size where the dense block takes less memory.
+		int m = block.rn;
+		int n = block.cn;
+		int maxRank = (int)(((Size_T)m) * n / (m + n));
+		std::vector<T> us, vs;            // columns of U and V
+		std::vector<char> usedRow(m, 0);
+		std::vector<T> row(n), col(m);
+		T norm2 = T(0.0);                 // |U * V^T|_F^2
+		// The rows whose kernel values are bounded by V(distance to the box of the columns) <= tiny are never pivots,
+		// the first pivot row is the nearest one to the box
+		T lo[Dims], hi[Dims];
+		for( int d = 0; d < Dims; ++d )
+		{
+			const T* xd = soa_.data() + ((Size_T)d) * n_ + block.cb;
+			lo[d] = *std::min_element(xd, xd + n);
+			hi[d] = *std::max_element(xd, xd + n);
+		}
+		int i = -1;
+		T dmin = T(0.0);
+		for( int r = 0; r < m; ++r )
+		{
+			T dd = T(0.0);
+			for( int d = 0; d < Dims; ++d )
+			{
+				T x = soa_[((Size_T)d) * n_ + block.rb + r];
+				T t = std::max(lo[d] - x, std::max(T(0.0), x - hi[d]));
+				dd += t * t;
+			}
+			dd = std::sqrt(dd);
+			if( rk_.GetValue(dd) <= tiny_ )
+			{
+				usedRow[r] = 1;
+			}
+			else if( i < 0 || dd < dmin )
+			{
+				i = r;
+				dmin = dd;
+			}
+		}
+		int k = 0;
+		while( k < maxRank && i >= 0 )
+		{
+			usedRow[i] = 1;
+			GetRow(block.rb + i, block.cb, n, row.data());
+			for( int l = 0; l < k; ++l )
+			{
+				Simd<T>::Axpy(-us[((Size_T)l) * m + i], vs.data() + ((Size_T)l) * n, row.data(), n);
+			}
+			int j = 0;
+			for( int c = 1; c < n; ++c )
+			{
+				if( std::abs(row[c]) > std::abs(row[j]) )
+				{
+					j = c;
+				}
+			}
+			if( std::abs(row[j]) <= tiny_ )
+			{
+				i = (int)(std::find(usedRow.begin(), usedRow.end(), 0) - usedRow.begin());
+				if( i == m )
+				{
+					break;
+				}
+				continue;
+			}
+
+			// Column j by symmetry: G(rows of the block, column j) = kernel from the node cb + j
+			GetRow(block.cb + j, block.rb, m, col.data());
+			for( int l = 0; l < k; ++l )
+			{
+				Simd<T>::Axpy(-vs[((Size_T)l) * n + j], us.data() + ((Size_T)l) * m, col.data(), m);
+			}
+			T p = T(1.0) / row[j];
+			for( int c = 0; c < n; ++c )
+			{
+				row[c] *= p;
+			}
+
+			T uu = Simd<T>::Dot(col.data(), col.data(), m);
+			T vv = Simd<T>::Dot(row.data(), row.data(), n);
+			for( int l = 0; l < k; ++l )
+			{
+				norm2 += T(2.0) * Simd<T>::Dot(us.data() + ((Size_T)l) * m, col.data(), m) * Simd<T>::Dot(vs.data() + ((Size_T)l) * n, row.data(), n);
+			}
+			norm2 += uu * vv;
+			us.insert(us.end(), col.begin(), col.end());
+			vs.insert(vs.end(), row.begin(), row.end());
+			++k;
+			if( uu * vv <= tol_ * tol_ * norm2 )
+			{
+				break;
+			}
+
+			int next = -1;
+			for( int r = 0; r < m; ++r )
+			{
+				if( !usedRow[r] && (next < 0 || std::abs(col[r]) > std::abs(col[next])) )
+				{
+					next = r;
+				}
+			}
+			if( next < 0 )
+			{
+				break;
+			}
+			i = next;
+		}
+		if( k >= maxRank )
+		{
+			return false;
+		}
+
+		block.rank = k;
+		block.a.resize(((Size_T)m + n) * k);
+		std::copy(us.begin(), us.end(), block.a.begin());
+		std::copy(vs.begin(), vs.end(), block.a.begin() + ((Size_T)m) * k);
+		return true;
+	}
+
+	template<typename T, int Dims>
+	void HMatrix<T, Dims>::Apply(const Block& block, const T* x, T* y, int jb) const
+	{
+	// y += B * x and, for an off-diagonal block, y += B^T * x, x and y are in the tree order, y starts at the element jb
+		int m = block.rn;
+		int n = block.cn;
+		bool diagonal = block.rb == block.cb;
+		const T* a = block.a.data();
+		T* yr = y + (block.rb - jb);
+		T* yc = y + (block.cb - jb);
+		if( block.rank < 0 )
+		{
+			for( int i = 0; i < m; ++i )
+			{
+				const T* ai = a + ((Size_T)i) * n;
+				yr[i] += Simd<T>::Dot(ai, x + block.cb, n);
+				if( !diagonal )
+				{
+					Simd<T>::Axpy(x[block.rb + i], ai, yc, n);
+				}
+			}
+			return;
+		}
+
+		const T* u = a;
+		const T* v = a + ((Size_T)m) * block.rank;
+		for( int l = 0; l < block.rank; ++l )
+		{
+			const T* ul = u + ((Size_T)l) * m;
+			const T* vl = v + ((Size_T)l) * n;
+			Simd<T>::Axpy(Simd<T>::Dot(vl, x + block.cb, n), ul, yr, m);
+			Simd<T>::Axpy(Simd<T>::Dot(ul, x + block.rb, m), vl, yc, n);
+		}
+	}
+
+	template<typename T, int Dims>
+	void HMatrix<T, Dims>::Multiply(const T* x, T* y) const
+	{
+		int n = n_;
+		int numParts = (int)parts_.size();
+		ArenaScope scope(*arena_);
+		T* xt = arena_->Allocate<T>(n);
+		T* yt = arena_->Allocate<T>(n);
+		T* acc = arena_->Allocate<T>(accSize_);
+		const std::vector<int>& index = tree_.GetIndex();
+		for( int j = 0; j < n; ++j )
+		{
+			xt[j] = x[index[j]];
+		}
+
+		auto part = [&](int p)
+		{
+			const Part& pp = parts_[p];
+			T* accp = acc + pp.offset;
+			std::fill(accp, accp + (pp.je - pp.jb), T(0.0));
+			for( int b = pp.bb; b < pp.be; ++b )
+			{
+				Apply(blocks_[b], xt, accp, pp.jb);
+			}
+		};
+		if( pool_ != nullptr && numParts > 1 )
+		{
+			pool_->ParallelFor(0, numParts, 1, [&](int lo, int hi)
+			{
+				for( int p = lo; p < hi; ++p )
+				{
+					part(p);
+				}
+			});
+		}
+		else
+		{
+			for( int p = 0; p < numParts; ++p )
+			{
+				part(p);
+			}
+		}
+
+		// The accumulators are added in the order of the parts
+		std::fill(yt, yt + n, T(0.0));
+		for( int p = 0; p < numParts; ++p )
+		{
+			const Part& pp = parts_[p];
+			const T* accp = acc + pp.offset;
+			for( int j = pp.jb; j < pp.je; ++j )
+			{
+				yt[j] += accp[j - pp.jb];
+			}
+		}
+		for( int j = 0; j < n; ++j )
+		{
+			y[index[j]] = yt[j];
+		}
+	}
+
+	template<typename T, int Dims>
+	void HMatrix<T, Dims>::GetResidual(const VectorT& x, const VectorT& b, VectorT& r) const
+	{
+	// r = b - G * x
+		r.resize(n_);
+		Multiply(x.data(), r.data());
+		for( int i = 0; i < n_; ++i )
+		{
+			r[i] = b[i] - r[i];
+		}
+	}
+
+	template<typename T, int Dims>
+	T HMatrix<T, Dims>::GetResidualNorm2(const VectorT& x, const VectorT& b) const
+	{
+	// ||b - G * x||_2, the residual is kept in the arena
+		ArenaScope scope(*arena_);
+		T* r = arena_->Allocate<T>(n_);
+		Multiply(x.data(), r);
+		for( int i = 0; i < n_; ++i )
+		{
+			r[i] = b[i] - r[i];
+		}
+		return Reduction<T>::Norm2(r, n_, Accumulation::Pairwise, pool_.get());
+	}
+
+	template<typename T, int Dims>
+	Size_T HMatrix<T, Dims>::GetMemorySize() const
+	{
+		Size_T size = 0;
+		for( Size_T b = 0; b < blocks_.size(); ++b )
+		{
+			size += blocks_[b].a.size();
+		}
+		return size;
+	}
+
+	template<typename T, int Dims>
+	int HMatrix<T, Dims>::GetMaxRank() const
+	{
+		int rank = 0;
+		for( Size_T b = 0; b < blocks_.size(); ++b )
+		{
+			rank = std::max(rank, blocks_[b].rank);
+		}
+		return rank;
+	}
+
+	template<typename T, int Dims>
+	T HMatrix<T, Dims>::GetDiameter(const typename KdTree<T, Dims>::Node& node)
+	{
+		T s = T(0.0);
+		for( int k = 0; k < Dims; ++k )
+		{
+			s += (node.hi[k] - node.lo[k]) * (node.hi[k] - node.lo[k]);
+		}
+		return std::sqrt(s);
+	}
+
+	template<typename T, int Dims>
+	T HMatrix<T, Dims>::GetDistance(const typename KdTree<T, Dims>::Node& s, const typename KdTree<T, Dims>::Node& t)
+	{
+	// Distance between the boxes
+		T r = T(0.0);
+		for( int k = 0; k < Dims; ++k )
+		{
+			T d = std::max(s.lo[k] - t.hi[k], std::max(T(0.0), t.lo[k] - s.hi[k]));
+			r += d * d;
+		}
+		return std::sqrt(r);
+	}
+
+} // end of mns namespace
+
+#endif // __HMATRIX_H__
@@ -11,6 +11,7 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #ifndef __IRK_H__
 #define __IRK_H__
 
+#include <cmath>
 #include "../common/defs.h"
 
 namespace mns 
@@ -19,24 +20,68 @@ namespace mns
 	class IRK
 	{
 	// Defines interface for calculating a Reproducing Kernel
+	// The kernels are radial: V(eta, x) depends on the distance |eta - x| only, so the implementations evaluate
+	// the kernel of a distance and the point versions reduce to it
 	public:
 		typedef typename Defs<T>::VectorT VectorT;
 		typedef typename Defs<T>::SpdMatrixT SpdMatrixT;
 
+		T    GetValue(T d) const { return GetValueImpl(d); };
+		void GetValues(const T* d, T* v, int n) const { GetValuesImpl(d, v, n); }; // v[j] = V(d[j]), v may coincide with d
+		T    GetDerivative(T d) const { return GetDerivativeImpl(d); }; // dV/dd, d >= 0
+
+		template <int Dims>
+		T    GetValue(const Point<T, Dims>& eta, const Point<T, Dims>& x) const { return GetValueImpl(GetDistance(eta, x)); };
+		template <int Dims>
+		void GetValues(const Point<T, Dims>& eta, const Point<T, Dims>* x, int n, T* v) const; // v[j] = V(eta, x[j])
+
+		template <int Dims>
+		static T GetDistance(const Point<T, Dims>& eta, const Point<T, Dims>& x);
+
+		int  GetSmoothness() const { return r_; };
+		T    GetEps() const { return eps_; };
+
 		virtual ~IRK() {};
 	protected:
-		IRK() {};
+		virtual T    GetValueImpl(T d) const = 0;
+		virtual void GetValuesImpl(const T* d, T* v, int n) const = 0;
+		virtual T    GetDerivativeImpl(T d) const = 0;
+
+		IRK(int r, T eps) : r_(r), eps_(eps) {};
+
+		int r_;   // smoothness of the space
+		T eps_;   // scaling parameter
 	private:
     	IRK(const IRK&);
 		IRK& operator =(const IRK&);
 		IRK& operator =(IRK&&);
-
-		int r_;
-		T eps_;
 	};
 
-	
-	
+	template <typename T>
+	template <int Dims>
+	void IRK<T>::GetValues(const Point<T, Dims>& eta, const Point<T, Dims>* x, int n, T* v) const
+	{
+	// The distances are put into v and the kernel is evaluated in place by the batch version
+		for( int j = 0; j < n; ++j )
+		{
+			v[j] = GetDistance(eta, x[j]);
+		}
+		GetValuesImpl(v, v, n);
+	}
+
+	template <typename T>
+	template <int Dims>
+	T IRK<T>::GetDistance(const Point<T, Dims>& eta, const Point<T, Dims>& x)
+	{
+	// Euclidean distance
+		T s = T(0.0);
+		for( int i = 0; i < Dims; ++i )
+		{
+			T d = eta.p[i] - x.p[i];
+			s += d * d;
+		}
+		return std::sqrt(s);
+	}
 
 } // end of mns namespace
 
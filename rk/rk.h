@@ -12,116 +12,249 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #define __RK_H__
 
 #include <cmath>
-#include <numeric>
 #include "irk.h"
+#include "../common/simd.h"
 
 namespace mns 
 {
-	template <typename T>
-	class RK  : public IRK<T> 
+	const int RKDynamic = -1; // the smoothness of RK<T> is given at run time
+
+	namespace rk
+	{
+	// Compile-time coefficients of the kernel polynomials and the unrolled Horner's rule
+		template <int N>
+		struct Fact
+		{
+			static const unsigned long long Value = N * Fact<N - 1>::Value;
+		};
+
+		template <>
+		struct Fact<0>
+		{
+			static const unsigned long long Value = 1;
+		};
+
+		template <int R, int K>
+		struct Coefficient
+		{
+			// a[k] = (2^(r-k) / (r-k)!) * ((r+k)! / k!) / ((2r)! / r!), the coefficient of t^(r-k) in P_r(t)
+			template <typename T>
+			static T Get() { return T((double)(1ull << (R - K)) / Fact<R - K>::Value * ((double)Fact<R + K>::Value / Fact<K>::Value) / ((double)Fact<2 * R>::Value / Fact<R>::Value)); };
+		};
+
+		template <int R, int K>
+		struct DCoefficient
+		{
+			// The coefficient of t^(r-k) in P_r'(t) - P_r(t), exp(-t) * (P_r' - P_r) is the derivative of the kernel in t
+			template <typename T>
+			static T Get() { return T(R - K + 1) * Coefficient<R, K - 1>::template Get<T>() - Coefficient<R, K>::template Get<T>(); };
+		};
+
+		template <int R>
+		struct DCoefficient<R, 0>
+		{
+			template <typename T>
+			static T Get() { return -Coefficient<R, 0>::template Get<T>(); };
+		};
+
+		template <template <int, int> class C, int R, int K>
+		struct Horner
+		{
+			// c[0] * t^K + ... + c[K], c[k] = C<R, k>
+			template <typename T>
+			static T Eval(T t) { return Horner<C, R, K - 1>::Eval(t) * t + C<R, K>::template Get<T>(); };
+			template <typename T>
+			static void Fill(T* c) { Horner<C, R, K - 1>::Fill(c); c[K] = C<R, K>::template Get<T>(); };
+		};
+
+		template <template <int, int> class C, int R>
+		struct Horner<C, R, 0>
+		{
+			template <typename T>
+			static T Eval(T) { return C<R, 0>::template Get<T>(); };
+			template <typename T>
+			static void Fill(T* c) { c[0] = C<R, 0>::template Get<T>(); };
+		};
+	} // end of rk namespace
+
+	template <typename T, int R = RKDynamic>
+	class RK : public IRK<T> 
 	{
-	// Computes a Reproducing Kernel
+	// Computes the Reproducing Kernel of the fixed smoothness R, see RK<T> below
+	// The coefficients are compile-time constants, Horner's rule for the kernel and its derivative is unrolled.
 	public:
-		RK(int r, T eps) : r_(r), eps_(eps) {};
+		explicit RK(T eps) : IRK<T>(R, eps) { rk::Horner<rk::Coefficient, R, R>::Fill(a_); };
+
+		static T Value(T t) { return std::exp(-t) * rk::Horner<rk::Coefficient, R, R>::Eval(t); };       // V_R of t = eps * d
+		static T Derivative(T t) { return std::exp(-t) * rk::Horner<rk::DCoefficient, R, R>::Eval(t); }; // dV_R/dt
+		static void Values(const T* a, T eps, const T* d, T* v, int n) { Simd<T>::template ExpPoly<R>(a, eps, d, v, n); };
 
-		//T BFun(T r) const;
-		//private
-		T ExpBySquaring(T x, int n) const;
-		long Fact(int n) const;
 		virtual ~RK() {};
 	protected:
-
-		RK() {};
+		virtual T    GetValueImpl(T d) const override { return Value(this->eps_ * std::abs(d)); };
+		virtual void GetValuesImpl(const T* d, T* v, int n) const override { Values(a_, this->eps_, d, v, n); };
+		virtual T    GetDerivativeImpl(T d) const override { return this->eps_ * Derivative(this->eps_ * std::abs(d)); };
 	private:
-		//T GetPolyCoefficients(int r, T eps, VectorT& a) const;
+		static_assert(R >= 0 && R <= 10, "the factorials of the coefficients are limited by 20!");
 
-		
+    	RK(const RK&);
+		RK& operator =(const RK&);
+		RK& operator =(RK&&);
+
+		T a_[R + 1]; // for the batch kernel
+	};
+
+	template <typename T>
+	class RK<T, RKDynamic> : public IRK<T> 
+	{
+	// Computes the Reproducing Kernel of the Bessel potential space H^(r+1)_eps (Sobolev type space of smoothness r + 1 with the scaling parameter eps):
+	// V_r(eta, x) = exp(-t) * P_r(t), t = eps * |eta - x|, P_r(t) = a[0] * t^r + a[1] * t^(r-1) + ... + a[r]
+	// The coefficients are computed once in the constructor, the polynomial is evaluated by Horner's rule.
+	// The batch version evaluates exp and the polynomial with the vector kernels (Simd<T>::ExpPoly).
+	// r = 1, 2, 3 are dispatched to the compile-time versions RK<T, r>.
+	public:
+		typedef typename IRK<T>::VectorT VectorT;
+
+		RK(int r, T eps);
+
+		const VectorT& GetCoefficients() const { return a_; };
+
+		static T ExpBySquaring(T x, int n);
+		static T Fact(int n);
+		virtual ~RK() {};
+	protected:
+		virtual T    GetValueImpl(T d) const override;
+		virtual void GetValuesImpl(const T* d, T* v, int n) const override;
+		virtual T    GetDerivativeImpl(T d) const override;
+	private:
+		static void GetPolyCoefficients(int r, VectorT& a);
+		static T    Horner(const VectorT& a, T t);
 
     	RK(const RK&);
 		RK& operator =(const RK&);
 		RK& operator =(RK&&);
 
-		int r_;
-		T eps_;
+		VectorT a_; // a_[0] is the leading coefficient
+		VectorT c_; // coefficients of P_r' - P_r
 	};
 
 	template<typename T> 
-	long RK<T>::Fact(int n) const
+	RK<T, RKDynamic>::RK(int r, T eps) : IRK<T>(r, eps)
 	{
-		return (n == 1)? 1: n * fact(n - 1);
+		GetPolyCoefficients(r, a_);
+		c_.resize(r + 1);
+		c_[0] = -a_[0];
+		for( int k = 1; k <= r; ++k )
+		{
+			c_[k] = (r - k + 1) * a_[k - 1] - a_[k];
+		}
 	}
 
 	template<typename T> 
-	T RK<T>::ExpBySquaring(T x, int n) const
-	// Calculates integer power
+	T RK<T, RKDynamic>::GetValueImpl(T d) const
 	{
-		if ( n < 0 )
+		T t = this->eps_ * std::abs(d);
+		switch( this->r_ )
 		{
-			return ExpBySquaring(T(1.0)/x, -n);
+		case 1:  return RK<T, 1>::Value(t);
+		case 2:  return RK<T, 2>::Value(t);
+		case 3:  return RK<T, 3>::Value(t);
+		default: return std::exp(-t) * Horner(a_, t);
 		}
-		if ( n == 0 )
+	}
+
+	template<typename T> 
+	void RK<T, RKDynamic>::GetValuesImpl(const T* d, T* v, int n) const
+	{
+		// The distances are not negative, no abs is taken here
+		switch( this->r_ )
 		{
-			return T(1.0);
+		case 1:  RK<T, 1>::Values(a_.data(), this->eps_, d, v, n); break;
+		case 2:  RK<T, 2>::Values(a_.data(), this->eps_, d, v, n); break;
+		case 3:  RK<T, 3>::Values(a_.data(), this->eps_, d, v, n); break;
+		default: Simd<T>::ExpPoly(a_.data(), this->r_, this->eps_, d, v, n); break;
 		}
-		if ( n == 1 )
+	}
+
+	template<typename T> 
+	T RK<T, RKDynamic>::GetDerivativeImpl(T d) const
+	{
+		T t = this->eps_ * std::abs(d);
+		switch( this->r_ )
+		{
+		case 1:  return this->eps_ * RK<T, 1>::Derivative(t);
+		case 2:  return this->eps_ * RK<T, 2>::Derivative(t);
+		case 3:  return this->eps_ * RK<T, 3>::Derivative(t);
+		default: return this->eps_ * std::exp(-t) * Horner(c_, t);
+		}
+	}
+
+	template<typename T> 
+	T RK<T, RKDynamic>::Horner(const VectorT& a, T t)
+	{
+		T s = a[0];
+		for( Size_T i = 1; i < a.size(); ++i )
 		{
-			return x;
+			s = s * t + a[i];
 		}
-		if ( n%2 == 0 )
+		return s;
+	}
+
+	template<typename T> 
+	void RK<T, RKDynamic>::GetPolyCoefficients(int r, VectorT& a)
+	// Calculates coefficients of the Reproducing Kernel polynomial part
+	// a[r] = a[r-1] = 1, a[k] = (2^(r-k) / (r-k)!) * ((k+1)...(k+r)) / ((r+1)...(2r)), k = 0, ..., r-2
+	{
+		a.assign(r + 1, T(1.0));
+		for( int k = 0; k <= r - 2; ++k )
 		{
-			return ExpBySquaring(x*x, n/2);
+			double s1 = 1.0;
+			for( int i = 1; i <= r - k; ++i )
+			{
+				s1 *= 2.0 / i;
+			}
+			double s2 = 1.0;
+			for( int i = 1; i <= r; ++i )
+			{
+				s2 *= ((double)(k + i)) / (r + i);
+			}
+			a[k] = (T)(s1 * s2);
 		}
+	}
 
-		return x * ExpBySquaring(x*x, (n-1)/2);
+	template<typename T> 
+	T RK<T, RKDynamic>::Fact(int n)
+	// Calculates n!, it is taken in T since it overflows the integer types for small n
+	{
+		T f = T(1.0);
+		for( int i = 2; i <= n; ++i )
+		{
+			f *= i;
+		}
+		return f;
 	}
 
-	//template<typename T> 
-	//T RK<T>::GetPolyCoefficients(int r, T eps, VectorT& a) const
-	//// Calculates coefficients of the Reproducing Kernel polynomial part
-	//{
-	//	T f = T(1.0);
-
-	//	//if( k2 > 1 )
-	//	//{
-	//	//	for( i = k1; i <= k2; ++i )
-	//	//		f *= i;
-	//	//}
-	//	return f;
-	//}
-
-
-//
-//void nsfa(int r, vec& a)
-///* forming a */
-//{
-// int k, i;
-// real s1, s2;
-//
-// a[r] = 1.;
-// if (r == 0) return;
-// a[r-1] = 1.;
-// if (r == 1) return;
-//
-// for(k=0; k<=r-2; k++) {
-//   s1 = 1.;
-//   for(i=1; i<=r-k; i++) s1 *= ((real)2./i);
-//   s2 = 1.;
-//   for(i=1; i<=r; i++) s2 *= ((real)(k+i)/(r+i));
-//   a[k] = s1 * s2;
-// }
-//  return;
-//}
-//
-//real nsp(int r, real t, vec& a)
-///* rk gorner*/
-//{
-// int i;
-// real s;
-//
-// s = a[0];
-// for(i=1; i<=r; i++) s = s*t + a[i];
-// return s;
-//}
+	template<typename T> 
+	T RK<T, RKDynamic>::ExpBySquaring(T x, int n)
+	// Calculates integer power
+	{
+		if( n < 0 )
+		{
+			x = T(1.0) / x;
+			n = -n;
+		}
+		T y = T(1.0);
+		while( n > 0 )
+		{
+			if( n % 2 != 0 )
+			{
+				y *= x;
+			}
+			x *= x;
+			n /= 2;
+		}
+		return y;
+	}
 
 } // end of MNS namespace
 
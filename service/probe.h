@@ -0,0 +1,259 @@
+/* 
+*************************************************************
+Copyright  2013 Igor Kohanovsky e-mail: Igor.Kohanovsky@gmail.com
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*************************************************************
+*/
+#pragma once
+#ifndef __PROBE_H__
+#define __PROBE_H__
+
+// Hot-path instrumentation: MNS_PROBE(phase) adds the time of the enclosing scope to the phase.
+// The probes are compiled in only if MNS_PROBES is defined, otherwise MNS_PROBE expands to nothing
+// and this header declares nothing else.
+#ifdef MNS_PROBES
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+#include "stopwatch.h"
+
+#ifndef MNS_THREAD_LOCAL
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define MNS_THREAD_LOCAL __declspec(thread)
+#else
+#define MNS_THREAD_LOCAL thread_local
+#endif
+#endif
+
+namespace mns
+{
+	// Phases of a fit, the time of nested probes is counted in both phases
+	enum class Phase : unsigned int
+	{
+		Assemble = 0x0,
+		Factorize = 0x1,
+		RCond = 0x2,
+		Solve = 0x3,
+		UpdateAdd = 0x4,
+		UpdateDel = 0x5,
+		Residual = 0x6,
+		Norm = 0x7,
+		Count = 0x8
+	};
+
+	struct PhaseStats
+	{
+		static const int NumBuckets = 32;
+
+		const char* name;
+		unsigned long long count;
+		unsigned long long totalNs;
+		unsigned long long histogram[NumBuckets]; // bucket b counts the calls of [2^b, 2^(b+1)) ns, the last one the longer ones
+	};
+
+	template <typename Dummy>
+	class ProbeRegistry
+	{
+	// Accumulators of the probes: a thread takes its own slot on its first probe and updates it by relaxed loads
+	// and stores (no locked instructions, no locks), Snapshot() reads all the slots concurrently with the updates.
+	// The threads beyond MaxThreads - 1 share the last slot, they update it by atomic additions.
+	public:
+		static void Add(Phase phase, unsigned long long ns);
+		static void Snapshot(std::vector<PhaseStats>& stats);
+		static void Reset();
+		static void Print(std::ostream& os);
+		static const char* GetName(Phase phase);
+
+		static const int MaxThreads = 64;
+	private:
+		typedef std::atomic<unsigned long long> Counter;
+		struct Accumulator
+		{
+			Counter count;
+			Counter totalNs;
+			Counter histogram[PhaseStats::NumBuckets];
+		};
+		struct Slot
+		{
+			Accumulator phases[(int)Phase::Count];
+		};
+
+		static int  GetSlot();
+		static int  GetBucket(unsigned long long ns);
+		static void Increment(Counter& c, unsigned long long v, bool shared);
+
+		static Slot slots_[MaxThreads]; // zero-initialized static storage
+		static std::atomic<int> numSlots_;
+	};
+
+	template <typename Dummy>
+	typename ProbeRegistry<Dummy>::Slot ProbeRegistry<Dummy>::slots_[ProbeRegistry<Dummy>::MaxThreads];
+
+	template <typename Dummy>
+	std::atomic<int> ProbeRegistry<Dummy>::numSlots_;
+
+	typedef ProbeRegistry<void> Probes;
+
+	template <typename Dummy>
+	const char* ProbeRegistry<Dummy>::GetName(Phase phase)
+	{
+		static const char* names[] = { "Assemble", "Factorize", "RCond", "Solve", "UpdateAdd", "UpdateDel", "Residual", "Norm" };
+		return ( phase < Phase::Count ) ? names[(int)phase] : "";
+	}
+
+	template <typename Dummy>
+	int ProbeRegistry<Dummy>::GetSlot()
+	{
+	// Returns the slot of the calling thread, taken on its first call
+		static MNS_THREAD_LOCAL int slot = 0; // slot + 1, 0 means no slot yet
+		if( slot == 0 )
+		{
+			int s = numSlots_.fetch_add(1);
+			slot = ( s < MaxThreads ) ? s + 1 : MaxThreads;
+		}
+		return slot - 1;
+	}
+
+	template <typename Dummy>
+	int ProbeRegistry<Dummy>::GetBucket(unsigned long long ns)
+	{
+		int b = 0;
+		while( ns > 1 && b < PhaseStats::NumBuckets - 1 )
+		{
+			ns >>= 1;
+			++b;
+		}
+		return b;
+	}
+
+	template <typename Dummy>
+	void ProbeRegistry<Dummy>::Increment(Counter& c, unsigned long long v, bool shared)
+	{
+		if( shared )
+		{
+			c.fetch_add(v, std::memory_order_relaxed);
+		}
+		else
+		{
+			c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+		}
+	}
+
+	template <typename Dummy>
+	void ProbeRegistry<Dummy>::Add(Phase phase, unsigned long long ns)
+	{
+		int slot = GetSlot();
+		bool shared = ( slot == MaxThreads - 1 );
+		Accumulator& a = slots_[slot].phases[(int)phase];
+		Increment(a.count, 1, shared);
+		Increment(a.totalNs, ns, shared);
+		Increment(a.histogram[GetBucket(ns)], 1, shared);
+	}
+
+	template <typename Dummy>
+	void ProbeRegistry<Dummy>::Snapshot(std::vector<PhaseStats>& stats)
+	{
+	// stats[p] is the sum over the threads for the phase p
+		stats.resize((int)Phase::Count);
+		for( int p = 0; p < (int)Phase::Count; ++p )
+		{
+			PhaseStats& s = stats[p];
+			s.name = GetName((Phase)p);
+			s.count = 0;
+			s.totalNs = 0;
+			for( int b = 0; b < PhaseStats::NumBuckets; ++b )
+			{
+				s.histogram[b] = 0;
+			}
+			for( int t = 0; t < MaxThreads; ++t )
+			{
+				const Accumulator& a = slots_[t].phases[p];
+				s.count += a.count.load(std::memory_order_relaxed);
+				s.totalNs += a.totalNs.load(std::memory_order_relaxed);
+				for( int b = 0; b < PhaseStats::NumBuckets; ++b )
+				{
+					s.histogram[b] += a.histogram[b].load(std::memory_order_relaxed);
+				}
+			}
+		}
+	}
+
+	template <typename Dummy>
+	void ProbeRegistry<Dummy>::Reset()
+	{
+	// Clears the accumulators, the probes running at the same time may be lost
+		for( int t = 0; t < MaxThreads; ++t )
+		{
+			for( int p = 0; p < (int)Phase::Count; ++p )
+			{
+				Accumulator& a = slots_[t].phases[p];
+				a.count.store(0, std::memory_order_relaxed);
+				a.totalNs.store(0, std::memory_order_relaxed);
+				for( int b = 0; b < PhaseStats::NumBuckets; ++b )
+				{
+					a.histogram[b].store(0, std::memory_order_relaxed);
+				}
+			}
+		}
+	}
+
+	template <typename Dummy>
+	void ProbeRegistry<Dummy>::Print(std::ostream& os)
+	{
+	// One line per phase that was called: calls, total and mean time, then the nonzero buckets as 2^b:count
+		std::vector<PhaseStats> stats;
+		Snapshot(stats);
+		for( size_t p = 0; p < stats.size(); ++p )
+		{
+			const PhaseStats& s = stats[p];
+			if( s.count == 0 )
+			{
+				continue;
+			}
+			os << std::left << std::setw(10) << s.name << std::right << std::setw(10) << s.count
+			   << std::setw(14) << std::fixed << std::setprecision(3) << 1.0e-6 * s.totalNs << " ms"
+			   << std::setw(14) << 1.0e-3 * s.totalNs / s.count << " us ";
+			for( int b = 0; b < PhaseStats::NumBuckets; ++b )
+			{
+				if( s.histogram[b] != 0 )
+				{
+					os << " 2^" << b << ":" << s.histogram[b];
+				}
+			}
+			os << std::endl;
+		}
+	}
+
+	class Probe final
+	{
+	// Adds the time from its construction to its destruction to the phase, timed by steady_clock: the clock of StopWatch
+	// (high_resolution_clock) may be the system clock, and a step back of it would give a negative duration
+	public:
+		explicit Probe(Phase phase) : phase_(phase), start_(std::chrono::steady_clock::now()) {};
+		~Probe() { Probes::Add(phase_, (unsigned long long)std::chrono::duration_cast<nanoseconds>(std::chrono::steady_clock::now() - start_).count()); };
+	private:
+		Phase phase_;
+		std::chrono::steady_clock::time_point start_;
+
+		Probe(const Probe&);
+		Probe& operator =(const Probe&);
+	};
+
+} // end of mns namespace
+
+#define MNS_PROBE_NAME2(name, line) name##line
+#define MNS_PROBE_NAME(name, line) MNS_PROBE_NAME2(name, line)
+#define MNS_PROBE(phase) mns::Probe MNS_PROBE_NAME(mnsProbe, __LINE__)(mns::Phase::phase)
+
+#else
+
+#define MNS_PROBE(phase)
+
+#endif // MNS_PROBES
+
+#endif // __PROBE_H__
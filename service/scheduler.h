@@ -0,0 +1,314 @@
+/* 
+*************************************************************
+Copyright  2013 Igor Kohanovsky e-mail: Igor.Kohanovsky@gmail.com
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*************************************************************
+*/
+#pragma once
+#ifndef __SCHEDULER_H__
+#define __SCHEDULER_H__
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#ifndef MNS_THREAD_LOCAL
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define MNS_THREAD_LOCAL __declspec(thread)
+#else
+#define MNS_THREAD_LOCAL thread_local
+#endif
+#endif
+
+namespace mns
+{
+	template <typename Dummy>
+	class SchedulerT final
+	{
+	// Work-stealing task scheduler shared by all the parallel code of the library (through ThreadPool)
+	// Every worker has its own deque: it pushes and pops its tasks at the back and steals the oldest tasks of the
+	// others from the front. The tasks submitted by the other threads go to the shared queue. Idle workers sleep
+	// until a task is pushed. A task may push tasks (nested parallelism), they are run by the same worker unless
+	// they are stolen. The workers are created on the first use of Get() with the numbers set by Configure().
+	public:
+		typedef std::function<void()> Task;
+
+		// Returns the scheduler, creates it on the first call
+		static SchedulerT& Get();
+		// Sets the number of workers (numWorkers < 0 means the number of processors - 1, the submitting thread
+		// is expected to work too) and pins worker w to processor w + 1 if pinned. If the scheduler exists, it is
+		// recreated, which must not happen while parallel work is running.
+		static void Configure(int numWorkers, bool pinned = false);
+		static int  GetNumProcs() { return std::max(1, (int)std::thread::hardware_concurrency()); };
+
+		int  GetNumWorkers() const { return (int)workers_.size(); };
+		bool IsPinned() const { return pinned_; };
+		bool IsWorker() const { return GetWorker() > 0; }; // the calling thread is a worker of the scheduler
+
+		// Queues a task, to the deque of the calling worker or to the shared queue
+		void Push(Task task);
+		// Runs one queued task on the calling thread, false if there are none
+		bool RunOne();
+
+		~SchedulerT();
+	private:
+		struct Queue
+		{
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		SchedulerT(int numWorkers, bool pinned);
+		bool Pop(Task& task);
+		void WorkerLoop(int worker);
+		static void Pin(int processor);
+		static int& GetWorker(); // worker index + 1 of the calling thread, 0 for the other threads
+
+		std::vector<std::thread> workers_;
+		std::vector<std::unique_ptr<Queue>> queues_; // queues_[0] is the shared queue, queues_[w + 1] the deque of worker w
+		std::atomic<int> queued_;
+		std::atomic<int> sleeping_;
+		std::atomic<unsigned int> victim_;
+		std::mutex sleepMutex_;
+		std::condition_variable wake_;
+		bool stop_; // guarded by sleepMutex_
+		bool pinned_;
+
+		static std::atomic<SchedulerT*> instance_;
+		static std::mutex instanceMutex_;
+		static int numWorkersConfig_;
+		static bool pinnedConfig_;
+
+		SchedulerT(const SchedulerT&);
+		SchedulerT& operator =(const SchedulerT&);
+	};
+
+	template <typename Dummy>
+	std::atomic<SchedulerT<Dummy>*> SchedulerT<Dummy>::instance_;
+
+	template <typename Dummy>
+	std::mutex SchedulerT<Dummy>::instanceMutex_;
+
+	template <typename Dummy>
+	int SchedulerT<Dummy>::numWorkersConfig_ = -1;
+
+	template <typename Dummy>
+	bool SchedulerT<Dummy>::pinnedConfig_ = false;
+
+	typedef SchedulerT<void> Scheduler;
+
+	template <typename Dummy>
+	SchedulerT<Dummy>& SchedulerT<Dummy>::Get()
+	{
+		SchedulerT* s = instance_.load(std::memory_order_acquire);
+		if( s == nullptr )
+		{
+			std::lock_guard<std::mutex> lock(instanceMutex_);
+			s = instance_.load(std::memory_order_relaxed);
+			if( s == nullptr )
+			{
+				s = new SchedulerT(numWorkersConfig_, pinnedConfig_);
+				instance_.store(s, std::memory_order_release);
+			}
+		}
+		return *s;
+	}
+
+	template <typename Dummy>
+	void SchedulerT<Dummy>::Configure(int numWorkers, bool pinned)
+	{
+		std::lock_guard<std::mutex> lock(instanceMutex_);
+		numWorkersConfig_ = numWorkers;
+		pinnedConfig_ = pinned;
+		delete instance_.exchange(nullptr);
+	}
+
+	template <typename Dummy>
+	int& SchedulerT<Dummy>::GetWorker()
+	{
+		static MNS_THREAD_LOCAL int worker = 0;
+		return worker;
+	}
+
+	template <typename Dummy>
+	SchedulerT<Dummy>::SchedulerT(int numWorkers, bool pinned) : queued_(0), sleeping_(0), victim_(0), stop_(false), pinned_(pinned)
+	{
+		if( numWorkers < 0 )
+		{
+			numWorkers = GetNumProcs() - 1;
+		}
+		for( int w = 0; w <= numWorkers; ++w )
+		{
+			queues_.push_back(std::unique_ptr<Queue>(new Queue()));
+		}
+		for( int w = 0; w < numWorkers; ++w )
+		{
+			workers_.push_back(std::thread(&SchedulerT::WorkerLoop, this, w));
+		}
+	}
+
+	template <typename Dummy>
+	SchedulerT<Dummy>::~SchedulerT()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex_);
+			stop_ = true;
+		}
+		wake_.notify_all();
+		for( auto& worker : workers_ )
+		{
+			worker.join();
+		}
+	}
+
+	template <typename Dummy>
+	void SchedulerT<Dummy>::Pin(int processor)
+	{
+	// Binds the calling thread to the processor, where the platform allows it
+		processor %= GetNumProcs();
+#if defined(_WIN32)
+		if( processor < (int)(8 * sizeof(DWORD_PTR)) )
+		{
+			SetThreadAffinityMask(GetCurrentThread(), ((DWORD_PTR)1) << processor);
+		}
+#elif defined(__linux__)
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(processor, &set);
+		pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+	}
+
+	template <typename Dummy>
+	void SchedulerT<Dummy>::Push(Task task)
+	{
+	// The waker takes sleepMutex_ so that a worker between its check of queued_ and its wait is not missed
+		int w = GetWorker();
+		Queue& q = *queues_[( w < (int)queues_.size() ) ? w : 0];
+		{
+			std::lock_guard<std::mutex> lock(q.mutex);
+			q.tasks.push_back(std::move(task));
+		}
+		++queued_;
+		if( sleeping_ > 0 )
+		{
+			{
+				std::lock_guard<std::mutex> lock(sleepMutex_);
+			}
+			wake_.notify_one();
+		}
+	}
+
+	template <typename Dummy>
+	bool SchedulerT<Dummy>::Pop(Task& task)
+	{
+	// Takes the newest task of the own deque, otherwise the oldest one of the shared queue or of another worker
+	// (stealing), the queues are tried in turn from a rotating index
+		if( queued_ <= 0 )
+		{
+			return false;
+		}
+
+		int w = GetWorker();
+		int count = (int)queues_.size();
+		if( w >= count )
+		{
+			w = 0;
+		}
+		if( w > 0 )
+		{
+			Queue& q = *queues_[w];
+			std::lock_guard<std::mutex> lock(q.mutex);
+			if( !q.tasks.empty() )
+			{
+				task = std::move(q.tasks.back());
+				q.tasks.pop_back();
+				--queued_;
+				return true;
+			}
+		}
+
+		int start = (int)(victim_++ % (unsigned int)count);
+		for( int k = 0; k < count; ++k )
+		{
+			int v = (start + k) % count;
+			if( v == w && w > 0 )
+			{
+				continue;
+			}
+			Queue& q = *queues_[v];
+			std::lock_guard<std::mutex> lock(q.mutex);
+			if( !q.tasks.empty() )
+			{
+				task = std::move(q.tasks.front());
+				q.tasks.pop_front();
+				--queued_;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	template <typename Dummy>
+	bool SchedulerT<Dummy>::RunOne()
+	{
+		Task task;
+		if( !Pop(task) )
+		{
+			return false;
+		}
+		task();
+		return true;
+	}
+
+	template <typename Dummy>
+	void SchedulerT<Dummy>::WorkerLoop(int worker)
+	{
+		GetWorker() = worker + 1;
+		if( pinned_ )
+		{
+			Pin(worker + 1);
+		}
+
+		for( ;; )
+		{
+			if( RunOne() )
+			{
+				continue;
+			}
+
+			std::unique_lock<std::mutex> lock(sleepMutex_);
+			++sleeping_;
+			while( !stop_ && queued_ <= 0 )
+			{
+				wake_.wait(lock);
+			}
+			--sleeping_;
+			if( stop_ )
+			{
+				return;
+			}
+		}
+	}
+
+} // end of mns namespace
+
+#endif // __SCHEDULER_H__
@@ -8,6 +8,11 @@ namespace mns
 	}
 
 
+	nanoseconds StopWatch::ElapsedNs() const
+	{ 
+		return std::chrono::duration_cast<nanoseconds>(clock::now() - start_);
+	}
+
 	microseconds StopWatch::ElapsedUs() const
 	{ 
 		return std::chrono::duration_cast<microseconds>(clock::now() - start_);
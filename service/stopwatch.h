@@ -8,6 +8,7 @@
 namespace mns 
 {
 typedef std::chrono::high_resolution_clock clock;
+typedef std::chrono::nanoseconds nanoseconds;
 typedef std::chrono::microseconds microseconds;
 typedef std::chrono::milliseconds milliseconds;
 
@@ -16,9 +17,10 @@ class StopWatch final
 	public:
 		StopWatch() : start_( clock::now()  ) {}
 		clock::time_point Restart();
-		double StopWatch::Elapsed() const;
+		double Elapsed() const;
 		milliseconds ElapsedMs() const;
 		microseconds ElapsedUs() const;
+		nanoseconds ElapsedNs() const;
 	    clock::time_point Now() const;
 		static std::time_t Convert(clock::time_point time_point);
 	private:
@@ -0,0 +1,214 @@
+/* 
+*************************************************************
+Copyright  2013 Igor Kohanovsky e-mail: Igor.Kohanovsky@gmail.com
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*************************************************************
+*/
+#pragma once
+#ifndef __THREADPOOL_H__
+#define __THREADPOOL_H__
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include "scheduler.h"
+
+namespace mns
+{
+	class ThreadPool final
+	{
+	// Handle of the shared Scheduler: the pools of all the objects submit their tasks to the same workers,
+	// so several fits running at the same time share the processors instead of starting threads of their own.
+	// numThreads bounds the threads taking part in the work of the pool (the calling thread included), it does not
+	// create them. The submitted tasks go to the queue of the pool, which is drained by at most numThreads - 1 runner
+	// tasks of the scheduler and by the thread in Wait(), so at most numThreads of them run at once. Wait() runs
+	// the tasks of its own pool only and sleeps until a task is submitted or completed, so it may be called from
+	// a task (a factorization run inside a task of another pool, say). ParallelFor() may be called from a task too
+	// (nested loops are run by the caller and the idle workers).
+	public:
+		explicit ThreadPool(int numThreads = 0);
+		~ThreadPool() {};
+
+		int  GetNumThreads() const { return numThreads_; };
+
+		// Queues a task; tasks may submit other tasks
+		void Submit(std::function<void()> task);
+		// Waits until all the queued tasks (including the ones submitted by tasks) are completed
+		void Wait();
+		// Calls body(lo, hi) for the chunks [lo, hi) of [begin, end), chunks are grain long and are taken dynamically
+		void ParallelFor(int begin, int end, int grain, const std::function<void(int, int)>& body);
+
+		static int GetNumProcs() { return Scheduler::GetNumProcs(); };
+	private:
+		struct Loop
+		{
+			std::atomic<int> next;
+			std::atomic<int> done;
+			int begin;
+			int end;
+			int grain;
+			int chunks;
+			const std::function<void(int, int)>* body; // used only for the chunks taken before done reaches chunks
+			std::mutex mutex;
+			std::condition_variable finished;
+
+			void Run();
+		};
+
+		// The runners share the queue with the pool, so a runner which starts after Wait() returned (and the pool
+		// was destroyed) finds the queue empty and returns
+		struct Queue
+		{
+			std::mutex mutex;
+			std::condition_variable changed; // a task is queued or completed
+			std::deque<std::function<void()>> tasks;
+			int active;  // queued and running tasks, guarded by mutex
+			int runners; // runner tasks pushed to the scheduler and not finished, guarded by mutex
+
+			bool RunOne(std::unique_lock<std::mutex>& lock);
+		};
+
+		int numThreads_;
+		std::shared_ptr<Queue> queue_;
+
+		ThreadPool(const ThreadPool&);
+		ThreadPool& operator =(const ThreadPool&);
+		ThreadPool& operator =(ThreadPool&&);
+	};
+
+	inline ThreadPool::ThreadPool(int numThreads) : numThreads_(numThreads), queue_(std::make_shared<Queue>())
+	{
+		if( numThreads_ <= 0 )
+		{
+			numThreads_ = Scheduler::Get().GetNumWorkers() + 1;
+		}
+		queue_->active = 0;
+		queue_->runners = 0;
+	}
+
+	inline bool ThreadPool::Queue::RunOne(std::unique_lock<std::mutex>& lock)
+	{
+	// Runs the oldest queued task without the lock, false if there are none
+		if( tasks.empty() )
+		{
+			return false;
+		}
+		std::function<void()> task = std::move(tasks.front());
+		tasks.pop_front();
+		lock.unlock();
+		task();
+		lock.lock();
+		--active;
+		changed.notify_all();
+		return true;
+	}
+
+	inline void ThreadPool::Submit(std::function<void()> task)
+	{
+	// A new runner is started while there are fewer than numThreads - 1 of them, a runner returns when the queue is empty
+		std::shared_ptr<Queue> queue = queue_;
+		Scheduler& scheduler = Scheduler::Get();
+		bool start = false;
+		{
+			std::lock_guard<std::mutex> lock(queue->mutex);
+			queue->tasks.push_back(std::move(task));
+			++queue->active;
+			if( queue->runners < std::min(numThreads_ - 1, scheduler.GetNumWorkers()) )
+			{
+				++queue->runners;
+				start = true;
+			}
+		}
+		queue->changed.notify_all();
+		if( start )
+		{
+			scheduler.Push([queue]()
+			{
+				std::unique_lock<std::mutex> lock(queue->mutex);
+				while( queue->RunOne(lock) )
+				{
+				}
+				--queue->runners;
+			});
+		}
+	}
+
+	inline void ThreadPool::Wait()
+	{
+	// The queued tasks of the pool are run here; when there are none, the remaining ones are running on the runners
+	// and the caller sleeps until one of them completes or submits a task
+		std::unique_lock<std::mutex> lock(queue_->mutex);
+		while( queue_->active > 0 )
+		{
+			if( !queue_->RunOne(lock) )
+			{
+				queue_->changed.wait(lock);
+			}
+		}
+	}
+
+	inline void ThreadPool::Loop::Run()
+	{
+		for( int c = next++; c < chunks; c = next++ )
+		{
+			int lo = begin + c * grain;
+			(*body)(lo, std::min(lo + grain, end));
+			if( ++done == chunks )
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				finished.notify_all();
+			}
+		}
+	}
+
+	inline void ThreadPool::ParallelFor(int begin, int end, int grain, const std::function<void(int, int)>& body)
+	{
+	// The helper tasks share the state of the loop, the caller takes chunks too and waits only for the chunks
+	// taken by the helpers, the helpers which start after the last chunk was taken return at once
+		if( end <= begin )
+		{
+			return;
+		}
+
+		grain = std::max(grain, 1);
+		int chunks = (end - begin + grain - 1) / grain;
+		int helpers = std::min(chunks, numThreads_) - 1;
+		if( helpers <= 0 )
+		{
+			body(begin, end);
+			return;
+		}
+
+		std::shared_ptr<Loop> loop = std::make_shared<Loop>();
+		loop->next = 0;
+		loop->done = 0;
+		loop->begin = begin;
+		loop->end = end;
+		loop->grain = grain;
+		loop->chunks = chunks;
+		loop->body = &body;
+
+		Scheduler& scheduler = Scheduler::Get();
+		helpers = std::min(helpers, scheduler.GetNumWorkers());
+		for( int i = 0; i < helpers; ++i )
+		{
+			scheduler.Push([loop]() { loop->Run(); });
+		}
+		loop->Run();
+
+		std::unique_lock<std::mutex> lock(loop->mutex);
+		while( loop->done < chunks )
+		{
+			loop->finished.wait(lock);
+		}
+	}
+
+} // end of mns namespace
+
+#endif // __THREADPOOL_H__
@@ -10,6 +10,9 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #ifndef __ISPD_H__
 #define __ISPD_H__
 
+#include <algorithm>
+#include <functional>
+#include <vector>
 #include "../common/defs.h"
 
 namespace mns 
@@ -24,9 +27,13 @@ namespace mns
 
 		Status Factorize() { return FactorizeImpl(); };
 		Status UpdateAdd(VectorT& a) { return UpdateAddImpl(a); };
+		Status UpdateAddBlock(const VectorT& a, int k) { return UpdateAddBlockImpl(a, k); }; // a is a column-major (n + k) x k block
 		Status UpdateDel(int ix) { return UpdateDelImpl(ix); };
+		Status UpdateDel(const std::vector<int>& ix) { return UpdateDelImpl(ix); };
 		Status Solve(VectorT& b) const { return SolveImpl(b); };
+		Status Solve(VectorT& b, int nrhs) const { return SolveImpl(b, nrhs); }; // b is a column-major n x nrhs block
 		T      GetRCond() const { return GetRCondImpl(); };
+		T      GetRCondEstimate() const { return GetRCondEstimateImpl(); }; // cheap estimate kept up to date by the updates
 
 		int    GetMatrixDim() const { return n_; };
 		bool   IsFactorized() const { return isFactorized_; };
@@ -35,11 +42,15 @@ namespace mns
 
 		virtual ~ISpd() {};
 	protected:
-		virtual	Status FactorizeImpl() abstract;
-		virtual Status SolveImpl(VectorT& b) const abstract;
+		virtual	Status FactorizeImpl() = 0;
+		virtual Status SolveImpl(VectorT& b) const = 0;
+		virtual Status SolveImpl(VectorT& b, int nrhs) const;
 		virtual Status UpdateAddImpl(VectorT& a) { return Status::Failure; };
+		virtual Status UpdateAddBlockImpl(const VectorT& a, int k);
 		virtual Status UpdateDelImpl(int ix) { return Status::Failure; };
+		virtual Status UpdateDelImpl(const std::vector<int>& ix);
 		virtual T	   GetRCondImpl() const { return T(); };
+		virtual T	   GetRCondEstimateImpl() const { return GetRCondImpl(); };
 
 		ISpd() {};
 
@@ -52,6 +63,77 @@ namespace mns
 		ISpd& operator =(ISpd&&);
 	};
 
+	template <typename T>
+	Status ISpd<T>::SolveImpl(VectorT& b, int nrhs) const
+	{
+	// Solves the system for nrhs right-hand sides one by one
+		int n = GetMatrixDim();
+		if( nrhs < 0 || b.size() < ((Size_T)n) * nrhs )
+		{
+			return Status::BadParameter;
+		}
+
+		VectorT x(n);
+		for( int c = 0; c < nrhs; ++c )
+		{
+			std::copy(b.begin() + ((Size_T)c) * n, b.begin() + ((Size_T)(c + 1)) * n, x.begin());
+			Status status = SolveImpl(x);
+			if( status != Status::Success )
+			{
+				return status;
+			}
+			std::copy(x.begin(), x.end(), b.begin() + ((Size_T)c) * n);
+		}
+		return Status::Success;
+	}
+
+	template <typename T>
+	Status ISpd<T>::UpdateAddBlockImpl(const VectorT& a, int k)
+	{
+	// Adds k rows/columns one by one, column c of a holds the new matrix column n + c (its first n + c + 1 elements are used)
+	// If an addition fails, the columns added before it are kept
+		int n = GetMatrixDim();
+		if( k < 0 || a.size() < ((Size_T)(n + k)) * k )
+		{
+			return Status::BadParameter;
+		}
+
+		for( int c = 0; c < k; ++c )
+		{
+			VectorT d(a.begin() + ((Size_T)c) * (n + k), a.begin() + ((Size_T)c) * (n + k) + n + c + 1);
+			Status status = UpdateAddImpl(d);
+			if( status != Status::Success )
+			{
+				return status;
+			}
+		}
+		return Status::Success;
+	}
+
+	template <typename T>
+	Status ISpd<T>::UpdateDelImpl(const std::vector<int>& ix)
+	{
+	// Deletes the rows/columns one by one, from the last one to the first one, so the remaining indices stay valid
+		int n = GetMatrixDim();
+		std::vector<int> del(ix);
+		std::sort(del.begin(), del.end(), std::greater<int>());
+		del.erase(std::unique(del.begin(), del.end()), del.end());
+		if( !del.empty() && (del.front() > n - 1 || del.back() < 0) )
+		{
+			return Status::BadParameter;
+		}
+
+		for( size_t i = 0; i < del.size(); ++i )
+		{
+			Status status = UpdateDelImpl(del[i]);
+			if( status != Status::Success )
+			{
+				return status;
+			}
+		}
+		return Status::Success;
+	}
+
 } // end of MNS namespace
 
 #endif // __ISPD_H__
@@ -0,0 +1,285 @@
+/* 
+*************************************************************
+Copyright  2013 Igor Kohanovsky e-mail: Igor.Kohanovsky@gmail.com
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*************************************************************
+*/
+#pragma once
+#ifndef __RFP_H__
+#define __RFP_H__
+
+#include <algorithm>
+#include <vector>
+#include "../common/arena.h"
+#include "spdkernels.h"
+
+namespace mns
+{
+	template <typename T>
+	class Rfp
+	{
+	// Rectangular Full Packed (RFP) storage of a symmetric matrix lower triangle (LAPACK format, TRANSR = 'N', UPLO = 'L')
+	// F. G. Gustavson, J. Wasniewski, J. J. Dongarra, J. Langou "Rectangular Full Packed Format for Cholesky's Algorithm:
+	// Factorization, Solution and Inversion" // ACM Trans. Math. Soft. Vol.37, No.2, 2010
+	//
+	// The matrix is split into A11 (n1 x n1), A21 (n2 x n1) and A22 (n2 x n2), n2 = n / 2, n1 = n - n2, and is stored
+	// in a column-major ld x n1 array, ld = n + 1 for even n and ld = n for odd n. The array has n(n+1)/2 elements.
+	// [A11; A21] occupies the lower part of the array, A22 is stored transposed in the upper part, so that its rows are contiguous.
+	// Factorization and solution are done with the column-oriented kernels for [A11; A21]
+	// and the row-oriented kernels for A22, both have contiguous inner loops.
+	public:
+		template <typename A>
+		static void FromPacked(int n, const std::vector<T, A>& ap, std::vector<T, A>& arf);
+		template <typename A>
+		static void ToPacked(int n, const std::vector<T, A>& arf, std::vector<T, A>& ap);
+
+		static Size_T GetIndex(int n, int i, int j);
+		// The row pointers of A22 are taken from the arena if it is given
+		static Status Factorize(int n, T* a, int nb, ThreadPool* pool = nullptr, Arena* arena = nullptr);
+		static void   Solve(int n, const T* a, T* b);
+		static void   Solve(int n, const T* a, T* w, int k, int nb, Arena* arena = nullptr);
+		static void   Multiply(int n, const T* a, T* x, T* t); // t is n elements of scratch
+	private:
+		struct Blocks
+		{
+			int n1, n2, ld;
+			Size_T a11, a22; // offsets of A11 (A21 follows it in the same columns) and of A22 rows
+		};
+		static Blocks GetBlocks(int n);
+		template <typename P>
+		static P** GetRows(const Blocks& b, P* a, Arena* arena, std::vector<P*>& rows);
+
+		Rfp();
+	};
+
+	template<typename T>
+	typename Rfp<T>::Blocks Rfp<T>::GetBlocks(int n)
+	{
+		Blocks b;
+		b.n2 = n / 2;
+		b.n1 = n - b.n2;
+		if( n % 2 == 0 )
+		{
+			b.ld = n + 1;
+			b.a11 = 1;
+			b.a22 = 0;
+		}
+		else
+		{
+			b.ld = n;
+			b.a11 = 0;
+			b.a22 = n;
+		}
+		return b;
+	}
+
+	template<typename T>
+	template <typename P>
+	P** Rfp<T>::GetRows(const Blocks& b, P* a, Arena* arena, std::vector<P*>& rows)
+	{
+	// Returns the row pointers of A22, the array is taken from the arena or is held by rows
+		P** r;
+		if( arena != nullptr )
+		{
+			r = arena->Allocate<P*>(b.n2);
+		}
+		else
+		{
+			rows.resize(b.n2 + 1);
+			r = &rows[0];
+		}
+		for( int i = 0; i < b.n2; ++i )
+		{
+			r[i] = a + b.a22 + ((Size_T)i) * b.ld;
+		}
+		return r;
+	}
+
+	template<typename T>
+	Size_T Rfp<T>::GetIndex(int n, int i, int j)
+	{
+	// Returns the position of the element (i,j), i >= j
+		Blocks b = GetBlocks(n);
+		if( j < b.n1 )
+		{
+			return b.a11 + i + ((Size_T)j) * b.ld;
+		}
+		return b.a22 + (j - b.n1) + ((Size_T)(i - b.n1)) * b.ld;
+	}
+
+	template<typename T>
+	template <typename A>
+	void Rfp<T>::FromPacked(int n, const std::vector<T, A>& ap, std::vector<T, A>& arf)
+	{
+	// Converts the row-packed lower triangle ap into the RFP array arf
+		arf.resize(((Size_T)n) * (n + 1) / 2);
+		Size_T ij = 0;
+		for( int i = 0; i < n; ++i )
+		{
+			for( int j = 0; j <= i; ++j )
+			{
+				arf[GetIndex(n, i, j)] = ap[ij++];
+			}
+		}
+	}
+
+	template<typename T>
+	template <typename A>
+	void Rfp<T>::ToPacked(int n, const std::vector<T, A>& arf, std::vector<T, A>& ap)
+	{
+	// Converts the RFP array arf into the row-packed lower triangle ap
+		ap.resize(((Size_T)n) * (n + 1) / 2);
+		Size_T ij = 0;
+		for( int i = 0; i < n; ++i )
+		{
+			for( int j = 0; j <= i; ++j )
+			{
+				ap[ij++] = arf[GetIndex(n, i, j)];
+			}
+		}
+	}
+
+	template<typename T>
+	Status Rfp<T>::Factorize(int n, T* a, int nb, ThreadPool* pool, Arena* arena)
+	{
+	// Computes Cholesky factor of the matrix stored in RFP format:
+	// L11 = chol(A11), L21 = A21 * L11^-T, L22 = chol(A22 - L21 * L21^T)
+		if( n <= 0 )
+		{
+			return Status::Success;
+		}
+
+		Blocks b = GetBlocks(n);
+		T* a11 = a + b.a11;
+		T* a21 = a11 + b.n1;
+		if( SpdKernels<T>::FactorizeLower(b.n1, a11, b.ld, nb, pool) != Status::Success )
+		{
+			return Status::IllConditionedMatrix;
+		}
+
+		if( b.n2 > 0 )
+		{
+			ArenaScope scope(arena);
+			std::vector<T*> buffer;
+			T** rows = GetRows(b, a, arena, buffer);
+			SpdKernels<T>::SolveRightLowerTrans(b.n2, b.n1, a11, b.ld, a21, b.ld, pool);
+			SpdKernels<T>::SyrkRows(b.n2, b.n1, a21, b.ld, rows, pool);
+			if( SpdKernels<T>::FactorizeRows(rows, b.n2, nb, pool) != Status::Success )
+			{
+				return Status::IllConditionedMatrix;
+			}
+		}
+		return Status::Success;
+	}
+
+	template<typename T>
+	void Rfp<T>::Solve(int n, const T* a, T* b)
+	{
+	// Solves L * L^T * x = b with the Cholesky factor in RFP format, b is overwritten by x
+		Blocks bl = GetBlocks(n);
+		const T* a11 = a + bl.a11;
+		const T* a22 = a + bl.a22;
+		int n1 = bl.n1, n2 = bl.n2;
+		T* b2 = b + n1;
+
+		// Solve [L11; L21] * y1 = b, columns of [L11; L21] are contiguous
+		for( int j = 0; j < n1; ++j )
+		{
+			const T* lj = a11 + ((Size_T)j) * bl.ld;
+			b[j] /= lj[j];
+			SpdKernels<T>::Axpy(-b[j], lj + j + 1, b + j + 1, n - j - 1);
+		}
+
+		// Solve L22 * y2 = b2, rows of L22 are contiguous
+		for( int i = 0; i < n2; ++i )
+		{
+			const T* li = a22 + ((Size_T)i) * bl.ld;
+			b2[i] = (b2[i] - SpdKernels<T>::Dot(li, b2, i)) / li[i];
+		}
+
+		// Solve L22^T * x2 = y2
+		for( int i = n2 - 1; i >= 0; --i )
+		{
+			const T* li = a22 + ((Size_T)i) * bl.ld;
+			b2[i] /= li[i];
+			SpdKernels<T>::Axpy(-b2[i], li, b2, i);
+		}
+
+		// Solve [L11^T L21^T] * x = y
+		for( int j = n1 - 1; j >= 0; --j )
+		{
+			const T* lj = a11 + ((Size_T)j) * bl.ld;
+			b[j] = (b[j] - SpdKernels<T>::Dot(lj + j + 1, b + j + 1, n - j - 1)) / lj[j];
+		}
+	}
+
+	template<typename T>
+	void Rfp<T>::Multiply(int n, const T* a, T* x, T* t)
+	{
+	// x = L * L^T * x with the Cholesky factor in RFP format: t = L^T * x, then x = L * t
+		Blocks bl = GetBlocks(n);
+		const T* a11 = a + bl.a11;
+		const T* a22 = a + bl.a22;
+		int n1 = bl.n1, n2 = bl.n2;
+		T* x2 = x + n1;
+		T* t2 = t + n1;
+
+		// t1 = [L11^T L21^T] * x, columns of [L11; L21] are contiguous
+		for( int j = 0; j < n1; ++j )
+		{
+			const T* lj = a11 + ((Size_T)j) * bl.ld;
+			t[j] = SpdKernels<T>::Dot(lj + j, x + j, n - j);
+		}
+
+		// t2 = L22^T * x2, rows of L22 are contiguous
+		std::fill(t2, t2 + n2, T(0.0));
+		for( int i = 0; i < n2; ++i )
+		{
+			SpdKernels<T>::Axpy(x2[i], a22 + ((Size_T)i) * bl.ld, t2, i + 1);
+		}
+
+		// x = [L11; L21] * t1
+		std::fill(x, x + n, T(0.0));
+		for( int j = 0; j < n1; ++j )
+		{
+			const T* lj = a11 + ((Size_T)j) * bl.ld;
+			SpdKernels<T>::Axpy(t[j], lj + j, x + j, n - j);
+		}
+
+		// x2 += L22 * t2
+		for( int i = 0; i < n2; ++i )
+		{
+			x2[i] += SpdKernels<T>::Dot(a22 + ((Size_T)i) * bl.ld, t2, i + 1);
+		}
+	}
+
+	template<typename T>
+	void Rfp<T>::Solve(int n, const T* a, T* w, int k, int nb, Arena* arena)
+	{
+	// Solves L * L^T * X = W for k right-hand sides with the Cholesky factor in RFP format,
+	// W is n x k row-major and is overwritten by X
+		if( n <= 0 )
+		{
+			return;
+		}
+
+		Blocks bl = GetBlocks(n);
+		const T* a11 = a + bl.a11;
+		T* w2 = w + ((Size_T)bl.n1) * k;
+		SpdKernels<T>::SolveCols(bl.n1, n, a11, bl.ld, w, k, nb);
+		if( bl.n2 > 0 )
+		{
+			ArenaScope scope(arena);
+			std::vector<const T*> buffer;
+			const T** rows = GetRows(bl, a, arena, buffer);
+			SpdKernels<T>::SolveRows(rows, bl.n2, w2, k, nb);
+			SpdKernels<T>::SolveRowsTrans(rows, bl.n2, w2, k, nb);
+		}
+		SpdKernels<T>::SolveColsTrans(bl.n1, n, a11, bl.ld, w, k, nb);
+	}
+
+} // end of mns namespace
+
+#endif // __RFP_H__
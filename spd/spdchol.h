@@ -10,10 +10,16 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 #ifndef __SPDCHOL_H__
 #define __SPDCHOL_H__
 
+#include <algorithm>
 #include <cmath>
 #include <limits>
+#include <memory>
 #include <numeric>
+#include "../common/arena.h"
 #include "ispd.h"
+#include "rfp.h"
+#include "spdkernels.h"
+#include "../service/probe.h"
 
 namespace mns 
 {
@@ -22,74 +28,187 @@ namespace mns
 	{
 	// Calculates Cholesky decomposition and solves the system of linear equations with symmetric positive-definite matrix
 	// Cholesky factor is being updated by means of Givens rotations
+	// The matrix (and its factor) is kept either in the row-packed layout or in the RFP layout, see SetLayout()
+	// Factorization and solution run on numThreads threads, see SetNumThreads(). The parallel factor is bitwise identical
+	// to the serial one, the parallel single right-hand side solution (packed layout) differs from the serial one
+	// by rounding errors only, the relative difference is of the order of n * epsilon.
+	// Scratch buffers of factorization, solution and condition estimation are taken from an arena (own one or the one
+	// given to SetArena()), so the repeated solutions do not allocate heap memory. Hence an object must not be used
+	// by several threads at once, even by its const methods.
+	// GetRCond() is Hager's estimate of the 1-norm condition, it takes about ten solutions. GetRCondEstimate() is
+	// the incremental condition estimate (ICE) of Bischof of the 2-norm condition: the approximate singular vectors
+	// of the extreme singular values of L are extended by each new row of the factor in O(n), see UpdateCondEstimate().
+	// It is an upper bound of the 2-norm reciprocal condition, on kernel Gram matrices it was seen up to about ten times
+	// the exact value, so it suits monitoring the growth of the condition rather than checking a tolerance.
+	// Factorize() builds the estimate by a pass over the rows of the factor. UpdateDel() applies its Givens rotations
+	// to the vectors as well, O(n) for a single row, and rebuilds them only if the deleted rows held most of their weight.
 	public:
-		SpdChol(SpdMatrixT&& spdMatrixT, int n) : m_(std::move(spdMatrixT)) { this->n_ = n; this->isFactorized_ = false; this->cond_ = T(0.0); };
+		typedef typename ISpd<T>::VectorT VectorT;
+		typedef typename ISpd<T>::SpdMatrixT SpdMatrixT;
+
+		SpdChol(SpdMatrixT&& spdMatrixT, int n) : m_(std::move(spdMatrixT)), nb_(DefaultBlockSize), layout_(SpdLayout::Packed), numThreads_(1), arena_(&ownArena_), iceMinNorm2_(T(0.0)), iceMaxNorm2_(T(0.0)) { this->n_ = n; this->isFactorized_ = false; this->cond_ = T(0.0); };
 		const SpdMatrixT& GetMatrix();
+		int  GetBlockSize() const { return nb_; };
+		void SetBlockSize(int nb) { nb_ = ( nb > 0 ) ? nb : DefaultBlockSize; };
+		SpdLayout GetLayout() const { return layout_; };
+		void SetLayout(SpdLayout layout);
+		int  GetNumThreads() const { return numThreads_; };
+		void SetNumThreads(int numThreads);
+		Arena& GetArena() const { return *arena_; };
+		void SetArena(Arena* arena) { arena_ = ( arena != nullptr ) ? arena : &ownArena_; }; // nullptr means the own arena
 		~SpdChol() {};
+
+		static const int DefaultBlockSize = 64; // tile size (rows/columns) of the blocked factorization
+		static const int RhsBlockSize = 16;     // number of right-hand sides solved together in Solve(b, nrhs)
 	private:
 		// Interface implementation
 		virtual Status FactorizeImpl() override;
 		virtual Status SolveImpl(VectorT& b) const override;
+		virtual Status SolveImpl(VectorT& b, int nrhs) const override;
 		virtual T	   GetRCondImpl() const override;
+		virtual T	   GetRCondEstimateImpl() const override;
 		virtual Status UpdateAddImpl(VectorT& a) override final;
+		virtual Status UpdateAddBlockImpl(const VectorT& a, int k) override final;
 		virtual Status UpdateDelImpl(int ix) override final;
+		virtual Status UpdateDelImpl(const std::vector<int>& ix) override final;
 		void   Compress(int ix);
 		void   GetGivensRotation(T x, T y, T& c, T& s) const;
-#if defined _WIN32 || defined _WIN64
-		__declspec(align(SSE_ALIGNMENTBOUNDARY))
-#endif
-		SpdMatrixT m_;
+		Size_T GetFactorIndex(int i, int j) const;
+		void   Grow(Size_T size);
+		template <typename P>
+		P**    GetRows(int n) const;
+		void   SolveFactor(T* b) const;
+		void   MultiplyFactor(T* x) const;
+		template <typename F>
+		T      EstimateNorm1(F apply) const;
+		void   InitCondEstimate();
+		void   UpdateCondEstimate(const T* row, int n);
+		void   RemoveCondEstimateRow(int ix, T& xx, T& yy);
+		void   RotateCondEstimate(int j, T c, T s);
+		void   FinishCondEstimateDel(const int* del, int m, T xx, T yy);
+		static void GetMaxEigenvector(T p, T q, T r, T& c, T& s);
+		SpdMatrixT m_; // the storage is aligned by the allocator of SpdMatrixT
+		int nb_;
+		SpdLayout layout_;
+		int numThreads_;
+		std::unique_ptr<ThreadPool> pool_; // nullptr for numThreads_ == 1
+		mutable Arena ownArena_;
+		Arena* arena_;
+		VectorT iceMin_; // L * iceMin_ = x, ||x|| = 1, ||iceMin_|| estimates 1 / sigma_min(L)
+		VectorT iceMax_; // iceMax_ = L^T * y, ||y|| = 1, ||iceMax_|| estimates sigma_max(L)
+		VectorT iceMaxY_; // y of iceMax_, needed by the deletions
+		T iceMinNorm2_;
+		T iceMaxNorm2_;
 	};
 
 	template<typename T> 
 	const typename SpdChol<T>::SpdMatrixT& SpdChol<T>::GetMatrix()
 	{
-		int n = GetMatrixDim(); 
+		int n = this->GetMatrixDim(); 
 		m_.resize(((Size_T)n) * (n + 1) / 2); 
 		return m_; 
 	};
 
+	template<typename T>
+	void SpdChol<T>::SetLayout(SpdLayout layout)
+	{
+	// Converts the matrix (or its Cholesky factor) to the given storage layout
+	// The conversion is out of place, the RFP array has the same n(n+1)/2 size as the packed one
+		if( layout == layout_ )
+		{
+			return;
+		}
+
+		int n = this->GetMatrixDim();
+		SpdMatrixT m;
+		if( layout == SpdLayout::Rfp )
+		{
+			Rfp<T>::FromPacked(n, m_, m);
+		}
+		else
+		{
+			Rfp<T>::ToPacked(n, m_, m);
+		}
+		m_.swap(m);
+		layout_ = layout;
+	}
+
+	template<typename T>
+	void SpdChol<T>::SetNumThreads(int numThreads)
+	{
+	// Sets the number of threads of factorization and solution, numThreads <= 0 means the number of processors
+		if( numThreads <= 0 )
+		{
+			numThreads = ThreadPool::GetNumProcs();
+		}
+		if( numThreads == numThreads_ )
+		{
+			return;
+		}
+
+		numThreads_ = numThreads;
+		pool_.reset(( numThreads > 1 ) ? new ThreadPool(numThreads) : nullptr);
+	}
+
+	template<typename T>
+	template <typename P>
+	P** SpdChol<T>::GetRows(int n) const
+	{
+	// Returns the row pointers of the first n rows of the packed triangle, m[i][j] == rows[i][j]
+	// The array is taken from the arena
+		P** rows = arena_->Allocate<P*>(n);
+		for( int i = 0; i < n; ++i )
+		{
+			rows[i] = const_cast<P*>(&m_[0]) + ((Size_T)i) * (i + 1) / 2;
+		}
+		return rows;
+	}
+
+	template<typename T>
+	Size_T SpdChol<T>::GetFactorIndex(int i, int j) const
+	{
+	// Returns the position of the element (i,j), i >= j, in the current layout
+		return ( layout_ == SpdLayout::Rfp ) ? Rfp<T>::GetIndex(this->GetMatrixDim(), i, j) : j + ((Size_T)i) * (i + 1) / 2;
+	}
+
 	template<typename T> 
 	Status SpdChol<T>::FactorizeImpl()
 	{
 	// Computes Cholessky factor of the symmetric positive-definite matrix
-		if( IsFactorized() )
+	// Packed layout: blocked left-looking algorithm over nb_ x nb_ tiles (see SpdKernels<T>::FactorizeRows)
+	// RFP layout: blocked algorithm over the RFP blocks (see Rfp<T>::Factorize)
+		MNS_PROBE(Factorize);
+		if( this->IsFactorized() )
 		{
 			return Status::Success;
 		}
 
-		int n = GetMatrixDim();
+		int n = this->GetMatrixDim();
+		if( n <= 0 )
+		{
+			this->isFactorized_ = true;
+			return Status::Success;
+		}
 
-		for( int i = 0; i < n; ++i ) 
+		ArenaScope scope(*arena_);
+		Status status;
+		if( layout_ == SpdLayout::Rfp )
 		{
-			for( int k = 0; k <= i; ++k ) 
-			{
-				T s = T(0.0);
-				for( int j = 0; j < k; ++j )
-				{
-					s += m_[j + ((Size_T)i) * (i + 1) / 2] * m_[j + ((Size_T)k) * (k + 1) / 2]; // m[i][j] * m[k][j]
-				}
+			status = Rfp<T>::Factorize(n, &m_[0], nb_, pool_.get(), arena_);
+		}
+		else
+		{
+			status = SpdKernels<T>::FactorizeRows(GetRows<T>(n), n, nb_, pool_.get());
+		}
 
-				if ( i == k )
-				{
-					Size_T ii = i + ((Size_T)i) * (i + 1) / 2;
-					T d = m_[ii]  - s;
-					if( d <= std::numeric_limits<T>::epsilon() )
-					{
-					// Matrix is not positive definite one
-						this->isFactorized_ = false;
-						return Status::IllConditionedMatrix;
-					}
-					m_[ii] = std::sqrt(d);
-				}
-				else
-				{
-					Size_T ik = k + ((Size_T)i) * (i + 1) / 2;
-					m_[ik] = ( T(1.0) / m_[k + ((Size_T)k) * (k + 1) / 2] * (m_[ik] - s) ); // m[k][k] * (m[i][k] - s))
-				}
-			}
+		if( status != Status::Success )
+		{
+		// Matrix is not positive definite one
+			this->isFactorized_ = false;
+			return Status::IllConditionedMatrix;
 		}
 		this->isFactorized_ = true;
+		InitCondEstimate();
 		return Status::Success;
 	}
 
@@ -97,36 +216,138 @@ namespace mns
 	Status SpdChol<T>::SolveImpl(VectorT& b) const
 	{
 	// Solves the linear equations system using the Cholesky decomposition
-		if( !IsFactorized() )
+		MNS_PROBE(Solve);
+		if( !this->IsFactorized() )
 		{
 			return Status::Failure;
 		}
 
-		int n = GetMatrixDim();
+		int n = this->GetMatrixDim();
 
 		if( b.size() < n )
 		{
 			return Status::BadParameter;
 		}
 
-		T  s;
+		if( n > 0 )
+		{
+			SolveFactor(&b[0]);
+		}
+		return Status::Success;
+	}
+
+	template<typename T> 
+	void SpdChol<T>::SolveFactor(T* b) const
+	{
+	// Solves L * L^T * x = b, b is overwritten by x
+		int n = this->GetMatrixDim();
+		if( layout_ == SpdLayout::Rfp )
+		{
+			Rfp<T>::Solve(n, &m_[0], b);
+			return;
+		}
+
+		if( pool_ && n > SpdKernels<T>::SolveBlockSize )
+		{
+			ArenaScope scope(*arena_);
+			const T** rows = GetRows<const T>(n);
+			SpdKernels<T>::SolveRowsParallel(rows, n, b, *pool_);
+			SpdKernels<T>::SolveRowsTransParallel(rows, n, b, *pool_);
+			return;
+		}
+
+		// Rows of the packed factor are contiguous: L * y = b by dot products, L^T * x = y by axpy updates
 		for( int i = 0; i < n; ++i )  
 		{
-			s = b[i];
-			for( int j = 0; j < i; ++j ) 
-			{
-				s -= m_[j + ((Size_T)i) * (i + 1) / 2] * b[j];
-			}
-			b[i] = s / m_[i + ((Size_T)i) * (i + 1) / 2];
+			const T* mi = &m_[0] + ((Size_T)i) * (i + 1) / 2;
+			b[i] = (b[i] - SpdKernels<T>::Dot(mi, b, i)) / mi[i];
 		}
 
 		for( int i = n - 1; i >= 0; --i ) 
 		{
-    		b[i] /= m_[i + ((Size_T)i) * (i + 1) / 2]; 
-			for( int j = 0; j < i; ++j )
+			const T* mi = &m_[0] + ((Size_T)i) * (i + 1) / 2;
+    		b[i] /= mi[i]; 
+			SpdKernels<T>::Axpy(-b[i], mi, b, i);
+		}
+	}
+
+	template<typename T>
+	Status SpdChol<T>::SolveImpl(VectorT& b, int nrhs) const
+	{
+	// Solves the linear equations system for nrhs right-hand sides stored column by column in b
+	// Right-hand sides are processed by RhsBlockSize blocks: a block is interleaved (transposed to row-major),
+	// so the factor is read once per block and the inner loops run across the right-hand sides
+	// Blocks are independent and are solved in parallel when the thread pool exists, every thread has its own interleaved block
+		MNS_PROBE(Solve);
+		if( !this->IsFactorized() )
+		{
+			return Status::Failure;
+		}
+
+		int n = this->GetMatrixDim();
+		if( nrhs < 0 || b.size() < ((Size_T)n) * nrhs )
+		{
+			return Status::BadParameter;
+		}
+
+		if( n == 0 || nrhs == 0 )
+		{
+			return Status::Success;
+		}
+
+		ArenaScope scope(*arena_);
+		const T** rows = ( layout_ == SpdLayout::Packed ) ? GetRows<const T>(n) : nullptr;
+
+		int kb = std::min(nrhs, (int)RhsBlockSize);
+		int nblocks = (nrhs + kb - 1) / kb;
+		int nslots = pool_ ? std::min(nblocks, pool_->GetNumThreads()) : 1;
+		int grain = (nblocks + nslots - 1) / nslots; // a chunk of grain blocks uses the slot blo / grain
+		Size_T wsize = ((Size_T)n) * kb;
+		T* ws = arena_->Allocate<T>(wsize * nslots);
+		Arena* rfpArena = ( nslots == 1 ) ? arena_ : nullptr;
+
+		auto solveBlocks = [&](int blo, int bhi)
+		{
+			T* w = ws + (blo / grain) * wsize;
+			for( int c0 = blo * kb; c0 < std::min(bhi * kb, nrhs); c0 += kb )
 			{
-				b[j] -= m_[j + ((Size_T)i) * (i + 1) / 2] * b[i];
+				int k = std::min(kb, nrhs - c0);
+				T* bc = &b[0] + ((Size_T)c0) * n;
+				for( int c = 0; c < k; ++c )
+				{
+					for( int i = 0; i < n; ++i )
+					{
+						w[((Size_T)i) * k + c] = bc[i + ((Size_T)c) * n];
+					}
+				}
+
+				if( layout_ == SpdLayout::Rfp )
+				{
+					Rfp<T>::Solve(n, &m_[0], w, k, nb_, rfpArena);
+				}
+				else
+				{
+					SpdKernels<T>::SolveRows(rows, n, w, k, nb_);
+					SpdKernels<T>::SolveRowsTrans(rows, n, w, k, nb_);
+				}
+
+				for( int c = 0; c < k; ++c )
+				{
+					for( int i = 0; i < n; ++i )
+					{
+						bc[i + ((Size_T)c) * n] = w[((Size_T)i) * k + c];
+					}
+				}
 			}
+		};
+
+		if( nslots > 1 )
+		{
+			pool_->ParallelFor(0, nblocks, grain, solveBlocks);
+		}
+		else
+		{
+			solveBlocks(0, nblocks);
 		}
 
 		return Status::Success;
@@ -140,86 +361,251 @@ namespace mns
 	//  Also see: Alg. 5.1 from
 	//  Nicholas J. Higham "A Survey of Condition Number Estimation for Triangular Matrices" // SIAM Review Vol.29, No.4, 1987
 	//  http://eprints.ma.man.ac.uk/695/01/covered/MIMS_ep2007_10.pdf
+		MNS_PROBE(RCond);
 
-		T cond = T(0.0);
 		if( !this->isFactorized_ )
 		{
-			return cond;
+			return T(0.0);
 		}
-		else
+		// A = L * L^T is not kept, so ||A||_1 is estimated by the same method as ||A^-1||_1
+		T norm1 = EstimateNorm1([this](T* x) { MultiplyFactor(x); });
+		T renorm1 = EstimateNorm1([this](T* x) { SolveFactor(x); });
+		T cond = norm1 * renorm1;
+		return ( cond > T(0.0) ) ? T(1.0) / cond : T(0.0);
+	}
+
+	template<typename T>
+	template <typename F>
+	T SpdChol<T>::EstimateNorm1(F apply) const
+	{
+	// Hager's estimate of ||B||_1 of the symmetric matrix B, apply(x) overwrites x by B * x
+		int n = this->GetMatrixDim();
+		ArenaScope scope(*arena_);
+		T* x = arena_->Allocate<T>(n);
+		T* z = arena_->Allocate<T>(n);
+		std::fill(x, x + n, T(1.0) / n);
+		T norm1 = T(0.0);
+		int ix = -1;
+		for( int k = 0; k < 5; ++k )
 		{
-			int n = GetMatrixDim();
-			T norm1 = T(0.0);
-			for( int j = 0; j < n; ++j )  
+			apply(x);
+			norm1 = T(0.0);
+			for( int i = 0; i < n; ++i )
 			{
-				T s = T(0.0);
-				for( int i = 0; i < j; ++i ) 
-				{
-					s += fabs(m_[i + ((Size_T)j) * (j + 1) / 2]);
-				}
-				for( int i = j; i < n; ++i ) 
-				{
-					s += fabs(m_[j + ((Size_T)i) * (i + 1) / 2]);
-				}
-				if ( s > norm1 )
+				norm1 += std::fabs(x[i]);
+				z[i] = ( x[i] >= T(0.0) ) ? T(1.0) : T(-1.0);
+			}
+			apply(z);
+
+			// z^T * x of the previous x: the mean of z at the first step, z[ix] later
+			T r = ( ix < 0 ) ? std::accumulate(z, z + n, T(0.0)) / n : z[ix];
+			int jx = 0;
+			for( int i = 1; i < n; ++i )
+			{
+				if( std::fabs(z[i]) > std::fabs(z[jx]) )
 				{
-					norm1 = s;
+					jx = i;
 				}
 			}
+			if( std::fabs(z[jx]) <= r || jx == ix )
+			{
+				break;
+			}
+			ix = jx;
+			std::fill(x, x + n, T(0.0));
+			x[ix] = T(1.0);
+		}
+		return norm1;
+	}
+
+	template<typename T>
+	void SpdChol<T>::MultiplyFactor(T* x) const
+	{
+	// x = L * L^T * x, the packed factor is read by rows: t = L^T * x by axpy updates, then x = L * t by dot products
+		int n = this->GetMatrixDim();
+		ArenaScope scope(*arena_);
+		T* t = arena_->Allocate<T>(n);
+		if( layout_ == SpdLayout::Rfp )
+		{
+			Rfp<T>::Multiply(n, &m_[0], x, t);
+			return;
+		}
+
+		std::fill(t, t + n, T(0.0));
+		for( int i = 0; i < n; ++i )
+		{
+			SpdKernels<T>::Axpy(x[i], &m_[0] + ((Size_T)i) * (i + 1) / 2, t, i + 1);
+		}
+		for( int i = 0; i < n; ++i )
+		{
+			x[i] = SpdKernels<T>::Dot(&m_[0] + ((Size_T)i) * (i + 1) / 2, t, i + 1);
+		}
+	}
 
-			T renorm1;
-			VectorT x(n, T(1.0)/n);
-			VectorT e(n);
-			int ix;
-			for( int k = 0; k < 4; ++k )
+	template<typename T>
+	T SpdChol<T>::GetRCondEstimateImpl() const
+	{
+	// rcond_2(A) = (sigma_min(L) / sigma_max(L))^2, it differs from the 1-norm one of GetRCond() by a factor of n at most
+		T p = iceMinNorm2_ * iceMaxNorm2_;
+		return ( this->isFactorized_ && p > T(0.0) ) ? T(1.0) / p : T(0.0);
+	}
+
+	template<typename T>
+	void SpdChol<T>::InitCondEstimate()
+	{
+	// Runs the incremental estimate over the rows of the factor, O(n^2)
+		int n = this->GetMatrixDim();
+		iceMin_.clear();
+		iceMax_.clear();
+		iceMaxY_.clear();
+		iceMinNorm2_ = T(0.0);
+		iceMaxNorm2_ = T(0.0);
+		if( layout_ == SpdLayout::Packed )
+		{
+			for( int i = 0; i < n; ++i )
 			{
-				SolveImpl(x);
+				UpdateCondEstimate(&m_[0] + ((Size_T)i) * (i + 1) / 2, i);
+			}
+			return;
+		}
 
-				for( int i = 0; i < n; ++i )
-				{
-					e[i] = ( x[i] >= T(0.0) ) ? T(1.0) : T(0.0);
-				}
+		ArenaScope scope(*arena_);
+		T* row = arena_->Allocate<T>(n);
+		for( int i = 0; i < n; ++i )
+		{
+			for( int j = 0; j <= i; ++j )
+			{
+				row[j] = m_[GetFactorIndex(i, j)];
+			}
+			UpdateCondEstimate(row, i);
+		}
+	}
 
-				SolveImpl(e);
+	template<typename T>
+	void SpdChol<T>::UpdateCondEstimate(const T* row, int n)
+	{
+	// Extends the estimate to the factor [L 0; v^T g], row = [v g], v has n elements
+	// C. H. Bischof "Incremental Condition Estimation" // SIAM J. Matrix Anal. Appl. Vol.11, No.2, 1990
+	// sigma_min: [L 0; v^T g] * [s * w; (c - s * v^T w) / g] = [s * x; c], (s, c) maximizes the norm of the new w
+	// sigma_max: [s * y; c]^T * [L 0; v^T g] = [s * z + c * v; c * g], (s, c) maximizes the norm of the new z
+		T g = row[n];
+		T alpha = SpdKernels<T>::Dot(row, iceMin_.data(), n);
+		T beta = SpdKernels<T>::Dot(row, iceMax_.data(), n);
+		T vv = SpdKernels<T>::Dot(row, row, n);
+		T g2 = g * g;
+		T c, s;
+
+		GetMaxEigenvector(iceMinNorm2_ + alpha * alpha / g2, -alpha / g2, T(1.0) / g2, s, c);
+		T w = (c - s * alpha) / g;
+		for( int i = 0; i < n; ++i )
+		{
+			iceMin_[i] *= s;
+		}
+		iceMin_.push_back(w);
+		iceMinNorm2_ = s * s * iceMinNorm2_ + w * w;
 
-				T r;
-				if( k == 0 )
-				{
-					r = std::accumulate(std::begin(e), std::end(e), T(0.0)) / n; 
-				}
-				else
-				{
-					r = e[ix]; 
-				}
+		GetMaxEigenvector(iceMaxNorm2_, beta, vv + g2, s, c);
+		for( int i = 0; i < n; ++i )
+		{
+			iceMax_[i] = s * iceMax_[i] + c * row[i];
+			iceMaxY_[i] *= s;
+		}
+		iceMax_.push_back(c * g);
+		iceMaxY_.push_back(c);
+		iceMaxNorm2_ = s * s * iceMaxNorm2_ + T(2.0) * s * c * beta + c * c * (vv + g2);
+	}
 
-				T maxAbsEl = std::fabs(e[0]);
-				ix = 0;
-				for( int i = 0; i < n; ++i ) 
-				{
-					T w = std::fabs(e[i]);
-					if( w > maxAbsEl )
-					{
-						ix = i;
-						maxAbsEl = w;  
-					}
-				}
+	template<typename T>
+	void SpdChol<T>::RemoveCondEstimateRow(int ix, T& xx, T& yy)
+	{
+	// Removes the row ix of L from the estimate before the rotations of a deletion: x loses x[ix] = l_ix^T * iceMin_,
+	// y loses y[ix] and iceMax_ loses y[ix] * l_ix; xx and yy sum the squares of the removed entries of x and y
+		const T* row = &m_[0] + ((Size_T)ix) * (ix + 1) / 2;
+		T xi = SpdKernels<T>::Dot(row, iceMin_.data(), ix + 1);
+		T yi = iceMaxY_[ix];
+		SpdKernels<T>::Axpy(-yi, row, iceMax_.data(), ix + 1);
+		xx += xi * xi;
+		yy += yi * yi;
+	}
 
-				if ( maxAbsEl <= r )
-				{
-					renorm1 = T(0.0);
-					for( int i = 0; i < n; ++i ) 
-					{
-						renorm1 += fabs(x[i]);
-					}
-					break;
-				}
+	template<typename T>
+	void SpdChol<T>::RotateCondEstimate(int j, T c, T s)
+	{
+	// The rotation of the columns j and j + 1 of L is applied to the vectors: (L * G) * (G^T * w) = L * w
+		T w1 = iceMin_[j];
+		T w2 = iceMin_[j + 1];
+		iceMin_[j]     =  c * w1 + s * w2;
+		iceMin_[j + 1] = -s * w1 + c * w2;
+		T z1 = iceMax_[j];
+		T z2 = iceMax_[j + 1];
+		iceMax_[j]     =  c * z1 + s * z2;
+		iceMax_[j + 1] = -s * z1 + c * z2;
+	}
 
-				x.assign(n, T(0.0));
-				x[ix] = T(1.0);
+	template<typename T>
+	void SpdChol<T>::FinishCondEstimateDel(const int* del, int m, T xx, T yy)
+	{
+	// The m sorted rows del were deleted and the columns rotated, L_del * G = [L' 0], so L' * (G^T * w)[0, n) = x_del and
+	// (G^T * (L_del^T * y_del))[0, n) = L'^T * y_del. The last m entries are dropped and x_del, y_del are scaled to unit norm.
+	// If most of the weight of x or y was deleted, the scaling would magnify the rounding errors and the estimate is rebuilt.
+		const T MinKept = T(1.0) / T(16.0);
+		int n = this->GetMatrixDim();
+		T kx = T(1.0) - xx;
+		T ky = T(1.0) - yy;
+		if( kx < MinKept || ky < MinKept )
+		{
+			InitCondEstimate();
+			return;
+		}
+
+		iceMin_.resize(n);
+		iceMax_.resize(n);
+		int k = 0, d = 0;
+		for( int i = 0; i < (int)iceMaxY_.size(); ++i )
+		{
+			if( d < m && del[d] == i )
+			{
+				++d;
+				continue;
 			}
-			cond = norm1 * renorm1;
+			iceMaxY_[k++] = iceMaxY_[i];
+		}
+		iceMaxY_.resize(n);
+
+		T sx = T(1.0) / std::sqrt(kx);
+		T sy = T(1.0) / std::sqrt(ky);
+		for( int i = 0; i < n; ++i )
+		{
+			iceMin_[i] *= sx;
+			iceMax_[i] *= sy;
+			iceMaxY_[i] *= sy;
 		}
-		return T(1.0) / cond;
+		iceMinNorm2_ = SpdKernels<T>::Dot(iceMin_.data(), iceMin_.data(), n);
+		iceMaxNorm2_ = SpdKernels<T>::Dot(iceMax_.data(), iceMax_.data(), n);
+	}
+
+	template<typename T>
+	void SpdChol<T>::GetMaxEigenvector(T p, T q, T r, T& c, T& s)
+	{
+	// (c, s) is the unit eigenvector of the largest eigenvalue of [p q; q r]
+		T h = (p - r) / T(2.0);
+		T lambda = (p + r) / T(2.0) + std::sqrt(h * h + q * q);
+		T c1 = q, s1 = lambda - p; // both are eigenvectors unless they vanish, the longer one is taken
+		T c2 = lambda - r, s2 = q;
+		if( c1 * c1 + s1 * s1 < c2 * c2 + s2 * s2 )
+		{
+			c1 = c2;
+			s1 = s2;
+		}
+		T norm = std::sqrt(c1 * c1 + s1 * s1);
+		if( norm == T(0.0) )
+		{
+			c = ( p >= r ) ? T(1.0) : T(0.0);
+			s = T(1.0) - c;
+			return;
+		}
+		c = c1 / norm;
+		s = s1 / norm;
 	}
 
 	template<typename T> 
@@ -227,43 +613,36 @@ namespace mns
 	{
 		// Updates the Cholesky factor after a symmetric column/row	addition
 		// d -  new matrix column
+		MNS_PROBE(UpdateAdd);
 
-		if( !IsFactorized() )
+		if( !this->IsFactorized() )
 		{
 			return Status::Failure;
 		}
 
-		int n = GetMatrixDim();
+		// Updates are done in the row-packed layout
+		SetLayout(SpdLayout::Packed);
+
+		int n = this->GetMatrixDim();
 		Size_T msize = n * (n + 1) / 2;
 		if( d.size() < n + 1 )
 		{
 			return Status::BadParameter;
 		}
 
-		if( m_.size() < msize + n + 1 )
-		{
-			m_.resize(msize + n + 1);
-		}
+		Grow(msize + n + 1);
 
 		// Calculate a new row of the matrix decomposition
 		// Solve L * y = d 
 		T s;
-		int i, j, k;
+		int i, j;
 		for( j = 0; j < n; ++j ) 
 		{
-			s = d[j];
-			for( k = 0; k < j; ++k ) 
-			{
-				s -= m_[k + ((Size_T)j) * (j + 1) / 2] * d[k];
-			}
-			d[j] = s / m_[j + ((Size_T)j) * (j + 1) / 2];
+			const T* mj = &m_[0] + ((Size_T)j) * (j + 1) / 2;
+			d[j] = (d[j] - SpdKernels<T>::Dot(mj, &d[0], j)) / mj[j];
 		}
 
-		s = T(0.0);
-		for( i = 0; i < n; ++i ) 
-		{
-			s += d[i] * d[i];
-		}
+		s = SpdKernels<T>::Dot(&d[0], &d[0], n);
 
 		s = d[n] - s;
 		if( s <= std::numeric_limits<T>::epsilon() ) 
@@ -277,21 +656,136 @@ namespace mns
 		{
 			m_[msize + i] = d[i];
 		}
+		UpdateCondEstimate(&d[0], n);
 
 		++this->n_;
 		return Status::Success;
 	}
 
+	template<typename T> 
+	Status SpdChol<T>::UpdateAddBlockImpl(const VectorT& a, int k)
+	{
+	// Updates the Cholesky factor after a symmetric addition of k rows/columns
+	// a - column-major (n + k) x k block, column c holds the new matrix column n + c (its first n + c + 1 elements are used)
+	// [L 0; Y^T L2] is the new factor: L * Y = B is solved for all k columns at once, L2 = chol(C - Y^T * Y)
+		MNS_PROBE(UpdateAdd);
+		if( !this->IsFactorized() )
+		{
+			return Status::Failure;
+		}
+
+		int n = this->GetMatrixDim();
+		if( k < 0 || a.size() < ((Size_T)(n + k)) * k )
+		{
+			return Status::BadParameter;
+		}
+
+		if( k == 0 )
+		{
+			return Status::Success;
+		}
+
+		// Updates are done in the row-packed layout
+		SetLayout(SpdLayout::Packed);
+
+		int nk = n + k;
+		Grow(((Size_T)nk) * (nk + 1) / 2);
+
+		ArenaScope scope(*arena_);
+		T** rows = GetRows<T>(nk);
+
+		// Solve L * Y = B, B = a(0:n, 0:k) is interleaved into the row-major w
+		T* w = arena_->Allocate<T>(((Size_T)n) * k);
+		for( int c = 0; c < k; ++c )
+		{
+			for( int i = 0; i < n; ++i )
+			{
+				w[((Size_T)i) * k + c] = a[i + ((Size_T)c) * nk];
+			}
+		}
+		if( n > 0 )
+		{
+			SpdKernels<T>::SolveRows(rows, n, w, k, nb_);
+		}
+
+		// New rows: Y^T and C - Y^T * Y, C(r,c) = a(n + c, r) for c <= r
+		for( int r = 0; r < k; ++r )
+		{
+			T* mr = rows[n + r];
+			for( int i = 0; i < n; ++i )
+			{
+				mr[i] = w[((Size_T)i) * k + r];
+			}
+			for( int c = 0; c <= r; ++c )
+			{
+				mr[n + c] = a[n + c + ((Size_T)r) * nk];
+			}
+		}
+		for( int i = 0; i < n; ++i )
+		{
+			const T* wi = w + ((Size_T)i) * k;
+			for( int r = 0; r < k; ++r )
+			{
+				SpdKernels<T>::Axpy(-wi[r], wi, rows[n + r] + n, r + 1);
+			}
+		}
+
+		// L2 = chol(C - Y^T * Y)
+		for( int r = 0; r < k; ++r )
+		{
+			rows[n + r] += n;
+		}
+		if( SpdKernels<T>::FactorizeRows(rows + n, k, nb_, pool_.get()) != Status::Success )
+		{
+			return Status::IllConditionedMatrix;
+		}
+		for( int r = 0; r < k; ++r )
+		{
+			UpdateCondEstimate(rows[n + r] - n, n + r);
+		}
+
+		this->n_ = nk;
+		return Status::Success;
+	}
+
+	template<typename T>
+	void SpdChol<T>::Grow(Size_T size)
+	{
+	// Resizes the matrix storage to hold at least size elements, the capacity grows geometrically,
+	// so a sequence of additions does not reallocate (and copy) the factor on every call
+		if( m_.size() >= size )
+		{
+			return;
+		}
+		if( m_.capacity() < size )
+		{
+			m_.reserve(std::max(size, m_.capacity() + m_.capacity() / 2));
+		}
+		m_.resize(size);
+	}
+
 	template<typename T> 
 	Status SpdChol<T>::UpdateDelImpl(int ix)
 	{
-		int n = GetMatrixDim();
+		MNS_PROBE(UpdateDel);
+		int n = this->GetMatrixDim();
 		// Calculates a new Cholesky factor for a matrix with deleted row and column 
 		if ( ix < 0 || ix > n - 1 )
 		{
 			return Status::BadParameter;
 		}
 
+		// Updates are done in the row-packed layout
+		SetLayout(SpdLayout::Packed);
+
+		// The condition estimate follows the rotations, unless it was not built for this factor
+		bool ice = ( (int)iceMin_.size() == n );
+		T xx = T(0.0), yy = T(0.0);
+		if( ice )
+		{
+			RemoveCondEstimateRow(ix, xx, yy);
+		}
+
 		if( ix < n - 1 )
 		{
 			Size_T ii1, ii2;
@@ -306,9 +800,13 @@ namespace mns
 				GetGivensRotation(m1, m2, c, s);
 				m_[ii1] =  c * m1 + s * m2;
 				m_[ii2] = -s * m1 + c * m2;
-				if ( i < n_ - 2 )
+				if( ice )
+				{
+					RotateCondEstimate(i, c, s);
+				}
+				if ( i < this->n_ - 2 )
 				{
-					for ( int k = i + 2; k < n_; ++k )
+					for ( int k = i + 2; k < this->n_; ++k )
 					{
 						ii1 = i   + ((Size_T)k) * (k + 1) / 2; 
 						ii2 = ip1 + ((Size_T)k) * (k + 1) / 2;
@@ -323,16 +821,118 @@ namespace mns
 			Compress(ix);
 		}           // if ( ix == n - 1 ) then we do nothing besides
 		--this->n_; // reducing the matrix dimension
+		if( ice )
+		{
+			FinishCondEstimateDel(&ix, 1, xx, yy);
+		}
+		else
+		{
+			InitCondEstimate();
+		}
+		return Status::Success;
+	}
+
+	template<typename T> 
+	Status SpdChol<T>::UpdateDelImpl(const std::vector<int>& ix)
+	{
+	// Calculates a new Cholesky factor for a matrix with a set of deleted rows and columns in a single pass
+	// The kept rows of L form a (n - m) x n matrix which is brought back to the lower triangular form by Givens rotations
+	// of adjacent columns. The rows are processed top down: a row gets all the rotations of the rows above it,
+	// then its entries to the right of its new diagonal are zeroed by new rotations, and the row is moved to its new place.
+		MNS_PROBE(UpdateDel);
+		int n = this->GetMatrixDim();
+		std::vector<int> del(ix);
+		std::sort(del.begin(), del.end());
+		del.erase(std::unique(del.begin(), del.end()), del.end());
+		if( del.empty() )
+		{
+			return Status::Success;
+		}
+		if( del.front() < 0 || del.back() > n - 1 )
+		{
+			return Status::BadParameter;
+		}
+
+		// Updates are done in the row-packed layout
+		SetLayout(SpdLayout::Packed);
+
+		struct Rotation
+		{
+			int j; // rotates the columns j - 1 and j
+			T c, s;
+		};
+		std::vector<Rotation> rotations;
+
+		// The condition estimate follows the rotations (in the order they are made), unless it was not built for this factor
+		bool ice = ( (int)iceMin_.size() == n );
+		T xx = T(0.0), yy = T(0.0);
+		if( ice )
+		{
+			for( size_t k = 0; k < del.size(); ++k )
+			{
+				RemoveCondEstimateRow(del[k], xx, yy);
+			}
+		}
+
+		// Rows above the first deleted one do not change
+		int p = del.front();
+		size_t d = 0;
+		for( int i = p; i < n; ++i )
+		{
+			if( d < del.size() && del[d] == i )
+			{
+				++d;
+				continue;
+			}
+
+			T* mi = &m_[0] + ((Size_T)i) * (i + 1) / 2;
+			for( size_t r = 0; r < rotations.size(); ++r )
+			{
+				const Rotation& rot = rotations[r];
+				T m1 = mi[rot.j - 1];
+				T m2 = mi[rot.j];
+				mi[rot.j - 1] =  rot.c * m1 + rot.s * m2;
+				mi[rot.j]     = -rot.s * m1 + rot.c * m2;
+			}
+
+			for( int j = i; j > p; --j )
+			{
+				Rotation rot;
+				rot.j = j;
+				GetGivensRotation(mi[j - 1], mi[j], rot.c, rot.s);
+				mi[j - 1] = rot.c * mi[j - 1] + rot.s * mi[j];
+				mi[j] = T(0.0);
+				rotations.push_back(rot);
+				if( ice )
+				{
+					RotateCondEstimate(j - 1, rot.c, rot.s);
+				}
+			}
+
+			// The new place of the row does not overlap the rows which are not processed yet
+			std::copy(mi, mi + p + 1, &m_[0] + ((Size_T)p) * (p + 1) / 2);
+			++p;
+		}
+
+		this->n_ = p;
+		if( ice )
+		{
+			FinishCondEstimateDel(&del[0], (int)del.size(), xx, yy);
+		}
+		else
+		{
+			InitCondEstimate();
+		}
 		return Status::Success;
 	}
 
 	template<typename T> 
 	void  SpdChol<T>::Compress(int ix)
 	{
-		if( ix < n_ - 1 )
+		if( ix < this->n_ - 1 )
 		{
 			Size_T ij = ((Size_T)ix) * (ix + 1) / 2;
-			for ( int i = ix + 1; i < n_; ++i )
+			for ( int i = ix + 1; i < this->n_; ++i )
 			{
 				for ( int j = 0; j < i; ++j )
 				{
@@ -0,0 +1,653 @@
+/* 
+*************************************************************
+Copyright  2013 Igor Kohanovsky e-mail: Igor.Kohanovsky@gmail.com
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*************************************************************
+*/
+#pragma once
+#ifndef __SPDKERNELS_H__
+#define __SPDKERNELS_H__
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+#include "../common/defs.h"
+#include "../common/simd.h"
+#include "../service/threadpool.h"
+
+namespace mns
+{
+	template <typename T>
+	class SpdKernels
+	{
+	// Computational kernels of the Cholesky factorization shared by the packed and the RFP storage layouts
+	// Row-oriented kernels work on an array of row pointers of a lower triangle: m[i][j] == rows[i][j], j <= i
+	// Column-oriented kernels work on column-major blocks with a leading dimension
+	// Kernels taking a ThreadPool run in parallel when the pool is given and run serially for nullptr.
+	// The parallel factorization kernels perform the same operations in the same order as the serial ones,
+	// so their results are bitwise identical. The parallel single right-hand side solves sum the dot products
+	// by blocks, their results differ from the serial ones by rounding errors only (of the order of n * eps * |x|).
+	public:
+		static const int TileSize = 64;
+		static const int SolveBlockSize = 256; // row block of the parallel single right-hand side solves
+
+		static T      Dot(const T* x, const T* y, int n) { return Simd<T>::Dot(x, y, n); };
+		static void   Dot2x2(const T* x0, const T* x1, const T* y0, const T* y1, int n, T* s) { Simd<T>::Dot2x2(x0, x1, y0, y1, n, s); };
+		static void   Axpy(T a, const T* x, T* y, int n) { Simd<T>::Axpy(a, x, y, n); };
+		static void   Axpy4(const T* a, const T* const* x, T* y, int n) { Simd<T>::Axpy4(a, x, y, n); };
+
+		// Row-oriented kernels
+		static Status FactorizeRows(T* const* rows, int n, int nb, ThreadPool* pool = nullptr);
+		static Status FactorizeRowsParallel(T* const* rows, int n, int nb, ThreadPool& pool);
+		static void   UpdateTile(T* const* rows, int ib, int ie, int kb, int ke, int jb, int je);
+		static Status FactorizeTile(T* const* rows, int ib, int ie, int kb, int ke);
+		static void   SolveRows(const T* const* rows, int n, T* w, int k, int nb);
+		static void   SolveRowsTrans(const T* const* rows, int n, T* w, int k, int nb);
+		static void   SolveRowsParallel(const T* const* rows, int n, T* b, ThreadPool& pool);
+		static void   SolveRowsTransParallel(const T* const* rows, int n, T* b, ThreadPool& pool);
+
+		// Column-oriented kernels
+		static Status FactorizeLower(int n, T* a, int lda, int nb, ThreadPool* pool = nullptr);
+		static Status FactorizeLowerUnblocked(int n, T* a, int lda);
+		static void   SolveRightLowerTrans(int m, int n, const T* l, int ldl, T* b, int ldb, ThreadPool* pool = nullptr);
+		static void   SyrkLower(int m, int k, const T* a, int lda, T* c, int ldc, ThreadPool* pool = nullptr);
+		static void   SyrkRows(int m, int k, const T* a, int lda, T* const* rows, ThreadPool* pool = nullptr);
+		static void   SolveCols(int n1, int n, const T* a, int lda, T* w, int k, int nb);
+		static void   SolveColsTrans(int n1, int n, const T* a, int lda, T* w, int k, int nb);
+
+		// Calls body(t) for t = 0..count-1, in parallel when the pool is given
+		static void   ForEach(ThreadPool* pool, int count, const std::function<void(int)>& body);
+	private:
+		SpdKernels();
+	};
+
+	template<typename T>
+	void SpdKernels<T>::ForEach(ThreadPool* pool, int count, const std::function<void(int)>& body)
+	{
+		if( pool != nullptr && pool->GetNumThreads() > 1 && count > 1 )
+		{
+			pool->ParallelFor(0, count, 1, [&](int lo, int hi)
+			{
+				for( int t = lo; t < hi; ++t )
+				{
+					body(t);
+				}
+			});
+		}
+		else
+		{
+			for( int t = 0; t < count; ++t )
+			{
+				body(t);
+			}
+		}
+	}
+
+	template<typename T>
+	Status SpdKernels<T>::FactorizeRows(T* const* rows, int n, int nb, ThreadPool* pool)
+	{
+	// Blocked left-looking Cholesky factorization of a row-oriented lower triangle:
+	// the triangle is split into nb x nb tiles, tile (I,K) is first updated by the tiles (I,J), (K,J), J < K,
+	// and then factorized in place
+		if( pool != nullptr && pool->GetNumThreads() > 1 && n > nb )
+		{
+			return FactorizeRowsParallel(rows, n, nb, *pool);
+		}
+
+		for( int ib = 0; ib < n; ib += nb )
+		{
+			int ie = std::min(ib + nb, n);
+			for( int kb = 0; kb <= ib; kb += nb )
+			{
+				int ke = std::min(kb + nb, n);
+				for( int jb = 0; jb < kb; jb += nb )
+				{
+					UpdateTile(rows, ib, ie, kb, ke, jb, jb + nb);
+				}
+
+				if( FactorizeTile(rows, ib, ie, kb, ke) != Status::Success )
+				{
+					return Status::IllConditionedMatrix;
+				}
+			}
+		}
+		return Status::Success;
+	}
+
+	template<typename T>
+	Status SpdKernels<T>::FactorizeRowsParallel(T* const* rows, int n, int nb, ThreadPool& pool)
+	{
+	// Task-based version of FactorizeRows: every tile is a task of the dependency graph
+	// Tile (I,K) needs the tiles (I,J), (K,J), J < K, and the diagonal tile (K,K) for I > K, so it waits for
+	// K dependencies if I == K and for 2K + 1 dependencies otherwise. A finished tile (I,K) releases
+	// the tiles (I,J), K < J <= I, and (I2,I), I2 > I. The tiles do exactly the same work as in the serial version.
+		int nt = (n + nb - 1) / nb;
+		Size_T ntiles = ((Size_T)nt) * (nt + 1) / 2;
+		std::unique_ptr<std::atomic<int>[]> deps(new std::atomic<int>[ntiles]);
+		for( int I = 0; I < nt; ++I )
+		{
+			for( int K = 0; K <= I; ++K )
+			{
+				deps[((Size_T)I) * (I + 1) / 2 + K] = ( I == K ) ? K : 2 * K + 1;
+			}
+		}
+
+		std::atomic<bool> failed(false);
+		std::function<void(int, int)> run;
+		auto release = [&](int I, int K)
+		{
+			if( --deps[((Size_T)I) * (I + 1) / 2 + K] == 0 )
+			{
+				pool.Submit([&run, I, K]() { run(I, K); });
+			}
+		};
+
+		run = [&](int I, int K)
+		{
+			if( !failed )
+			{
+				int ib = I * nb, ie = std::min(ib + nb, n);
+				int kb = K * nb, ke = std::min(kb + nb, n);
+				for( int jb = 0; jb < kb; jb += nb )
+				{
+					UpdateTile(rows, ib, ie, kb, ke, jb, jb + nb);
+				}
+				if( FactorizeTile(rows, ib, ie, kb, ke) != Status::Success )
+				{
+					failed = true;
+				}
+			}
+
+			// The remaining tasks are still run (and skipped) after a failure, so that Wait() returns
+			for( int J = K + 1; J <= I; ++J )
+			{
+				release(I, J);
+			}
+			for( int I2 = I + 1; I2 < nt; ++I2 )
+			{
+				release(I2, I);
+			}
+		};
+
+		pool.Submit([&run]() { run(0, 0); });
+		pool.Wait();
+		return failed ? Status::IllConditionedMatrix : Status::Success;
+	}
+
+	template<typename T>
+	void SpdKernels<T>::UpdateTile(T* const* rows, int ib, int ie, int kb, int ke, int jb, int je)
+	{
+	// Performs m[I][K] -= m[I][J] * m[K][J]^T for the tile rows I = [ib, ie), K = [kb, ke), J = [jb, je)
+	// Rows are processed by pairs (2x2 register blocking), so every loaded element is used twice
+		int nj = je - jb;
+		bool diag = ( ib == kb );
+		for( int i = ib; i < ie; i += 2 )
+		{
+			const T* x0 = rows[i] + jb;
+			int klim0 = diag ? i + 1 : ke; // row i is updated for k < klim0
+			if( i + 1 < ie )
+			{
+				const T* x1 = rows[i + 1] + jb;
+				int klim1 = diag ? i + 2 : ke;
+				int k = kb;
+				for( ; k + 1 < klim0; k += 2 )
+				{
+					const T* y0 = rows[k] + jb;
+					const T* y1 = rows[k + 1] + jb;
+					T s[4];
+					Dot2x2(x0, x1, y0, y1, nj, s);
+					rows[i][k]         -= s[0];
+					rows[i][k + 1]     -= s[1];
+					rows[i + 1][k]     -= s[2];
+					rows[i + 1][k + 1] -= s[3];
+				}
+				for( ; k < klim1; ++k )
+				{
+					const T* y = rows[k] + jb;
+					if( k < klim0 )
+					{
+						rows[i][k] -= Dot(x0, y, nj);
+					}
+					rows[i + 1][k] -= Dot(x1, y, nj);
+				}
+			}
+			else
+			{
+				for( int k = kb; k < klim0; ++k )
+				{
+					rows[i][k] -= Dot(x0, rows[k] + jb, nj);
+				}
+			}
+		}
+	}
+
+	template<typename T>
+	Status SpdKernels<T>::FactorizeTile(T* const* rows, int ib, int ie, int kb, int ke)
+	{
+	// Completes the tile (I,K) which has already been updated by all the tiles to the left of it:
+	// Cholesky factorization for a diagonal tile, triangular solve with m[K][K] otherwise
+		for( int i = ib; i < ie; ++i )
+		{
+			T* ri = rows[i];
+			int kend = std::min(ke, i + 1);
+			for( int k = kb; k < kend; ++k )
+			{
+				T s = Dot(ri + kb, rows[k] + kb, k - kb);
+				if( k == i )
+				{
+					T d = ri[i] - s;
+					if( d <= std::numeric_limits<T>::epsilon() )
+					{
+					// Matrix is not positive definite one
+						return Status::IllConditionedMatrix;
+					}
+					ri[i] = std::sqrt(d);
+				}
+				else
+				{
+					ri[k] = ( T(1.0) / rows[k][k] * (ri[k] - s) ); // m[k][k] * (m[i][k] - s))
+				}
+			}
+		}
+		return Status::Success;
+	}
+
+	template<typename T>
+	void SpdKernels<T>::SolveRows(const T* const* rows, int n, T* w, int k, int nb)
+	{
+	// Solves L * X = W for k right-hand sides, W is n x k row-major (right-hand sides are interleaved),
+	// so the inner loops run across the right-hand sides. L is processed by nb x nb tiles.
+		for( int ib = 0; ib < n; ib += nb )
+		{
+			int ie = std::min(ib + nb, n);
+			for( int jb = 0; jb < ib; jb += nb )
+			{
+				for( int i = ib; i < ie; ++i )
+				{
+					const T* ri = rows[i];
+					T* wi = w + ((Size_T)i) * k;
+					for( int j = jb; j < jb + nb; ++j )
+					{
+						Axpy(-ri[j], w + ((Size_T)j) * k, wi, k);
+					}
+				}
+			}
+
+			for( int i = ib; i < ie; ++i )
+			{
+				const T* ri = rows[i];
+				T* wi = w + ((Size_T)i) * k;
+				for( int j = ib; j < i; ++j )
+				{
+					Axpy(-ri[j], w + ((Size_T)j) * k, wi, k);
+				}
+				T r = T(1.0) / ri[i];
+				for( int c = 0; c < k; ++c )
+				{
+					wi[c] *= r;
+				}
+			}
+		}
+	}
+
+	template<typename T>
+	void SpdKernels<T>::SolveRowsTrans(const T* const* rows, int n, T* w, int k, int nb)
+	{
+	// Solves L^T * X = W for k right-hand sides, W is n x k row-major
+		for( int ib = ((n - 1) / nb) * nb; ib >= 0; ib -= nb )
+		{
+			int ie = std::min(ib + nb, n);
+			for( int i = ie - 1; i >= ib; --i )
+			{
+				const T* ri = rows[i];
+				T* wi = w + ((Size_T)i) * k;
+				T r = T(1.0) / ri[i];
+				for( int c = 0; c < k; ++c )
+				{
+					wi[c] *= r;
+				}
+				for( int j = ib; j < i; ++j )
+				{
+					Axpy(-ri[j], wi, w + ((Size_T)j) * k, k);
+				}
+			}
+
+			for( int jb = 0; jb < ib; jb += nb )
+			{
+				for( int i = ib; i < ie; ++i )
+				{
+					const T* ri = rows[i];
+					const T* wi = w + ((Size_T)i) * k;
+					for( int j = jb; j < jb + nb; ++j )
+					{
+						Axpy(-ri[j], wi, w + ((Size_T)j) * k, k);
+					}
+				}
+			}
+		}
+	}
+
+	template<typename T>
+	void SpdKernels<T>::SolveRowsParallel(const T* const* rows, int n, T* b, ThreadPool& pool)
+	{
+	// Solves L * x = b: for a row block I the dot products with the solved part b[0, ib) are computed in parallel,
+	// then the diagonal block is solved serially
+		for( int ib = 0; ib < n; ib += SolveBlockSize )
+		{
+			int ie = std::min(ib + SolveBlockSize, n);
+			if( ib > 0 )
+			{
+				pool.ParallelFor(ib, ie, 8, [&](int lo, int hi)
+				{
+					for( int i = lo; i < hi; ++i )
+					{
+						b[i] -= Dot(rows[i], b, ib);
+					}
+				});
+			}
+			for( int i = ib; i < ie; ++i )
+			{
+				b[i] = (b[i] - Dot(rows[i] + ib, b + ib, i - ib)) / rows[i][i];
+			}
+		}
+	}
+
+	template<typename T>
+	void SpdKernels<T>::SolveRowsTransParallel(const T* const* rows, int n, T* b, ThreadPool& pool)
+	{
+	// Solves L^T * x = b: a row block I is solved serially, then b[0, ib) -= L(I, 0:ib)^T * x(I)
+	// is computed in parallel over the chunks of [0, ib)
+		for( int ib = ((n - 1) / SolveBlockSize) * SolveBlockSize; ib >= 0; ib -= SolveBlockSize )
+		{
+			int ie = std::min(ib + SolveBlockSize, n);
+			for( int i = ie - 1; i >= ib; --i )
+			{
+				b[i] /= rows[i][i];
+				Axpy(-b[i], rows[i] + ib, b + ib, i - ib);
+			}
+			if( ib > 0 )
+			{
+				int grain = std::max(1024, ib / (4 * pool.GetNumThreads()));
+				pool.ParallelFor(0, ib, grain, [&](int lo, int hi)
+				{
+					for( int i = ib; i < ie; ++i )
+					{
+						Axpy(-b[i], rows[i] + lo, b + lo, hi - lo);
+					}
+				});
+			}
+		}
+	}
+
+	template<typename T>
+	Status SpdKernels<T>::FactorizeLower(int n, T* a, int lda, int nb, ThreadPool* pool)
+	{
+	// Blocked right-looking Cholesky factorization of the lower triangle of the n x n column-major matrix a
+		for( int jb = 0; jb < n; jb += nb )
+		{
+			int jn = std::min(nb, n - jb);
+			T* ajj = a + jb + ((Size_T)jb) * lda;
+			if( FactorizeLowerUnblocked(jn, ajj, lda) != Status::Success )
+			{
+				return Status::IllConditionedMatrix;
+			}
+
+			int m = n - jb - jn;
+			if( m > 0 )
+			{
+				T* p = ajj + jn;                        // panel below the diagonal block
+				T* c = ajj + jn + ((Size_T)jn) * lda;   // trailing matrix
+				SolveRightLowerTrans(m, jn, ajj, lda, p, lda, pool);
+				SyrkLower(m, jn, p, lda, c, lda, pool);
+			}
+		}
+		return Status::Success;
+	}
+
+	template<typename T>
+	Status SpdKernels<T>::FactorizeLowerUnblocked(int n, T* a, int lda)
+	{
+	// Right-looking Cholesky factorization of a column-major lower triangle, all updates are column axpy-s
+		for( int j = 0; j < n; ++j )
+		{
+			T* aj = a + ((Size_T)j) * lda;
+			T d = aj[j];
+			if( d <= std::numeric_limits<T>::epsilon() )
+			{
+			// Matrix is not positive definite one
+				return Status::IllConditionedMatrix;
+			}
+			d = std::sqrt(d);
+			aj[j] = d;
+			T r = T(1.0) / d;
+			for( int i = j + 1; i < n; ++i )
+			{
+				aj[i] *= r;
+			}
+			for( int c = j + 1; c < n; ++c )
+			{
+				T* ac = a + ((Size_T)c) * lda;
+				Axpy(-aj[c], aj + c, ac + c, n - c);
+			}
+		}
+		return Status::Success;
+	}
+
+	template<typename T>
+	void SpdKernels<T>::SolveRightLowerTrans(int m, int n, const T* l, int ldl, T* b, int ldb, ThreadPool* pool)
+	{
+	// Solves X * L^T = B for the m x n column-major B, L is n x n column-major lower triangle, B is overwritten by X
+	// B is processed by TileSize x TileSize blocks: block (I,C) is updated by the blocks (I,P), P < C, and then solved with L(C,C)
+	// Row blocks are independent
+		ForEach(pool, (m + TileSize - 1) / TileSize, [&](int t)
+		{
+			int ib = t * TileSize;
+			int mi = std::min((int)TileSize, m - ib);
+			for( int cb = 0; cb < n; cb += TileSize )
+			{
+				int ce = std::min(cb + TileSize, n);
+				for( int pb = 0; pb <= cb; pb += TileSize )
+				{
+					for( int c = cb; c < ce; ++c )
+					{
+						T* bc = b + ib + ((Size_T)c) * ldb;
+						int pe = std::min(pb + TileSize, c);
+						int p = pb;
+						for( ; p + 3 < pe; p += 4 )
+						{
+							T a[4];
+							const T* x[4];
+							for( int q = 0; q < 4; ++q )
+							{
+								a[q] = -l[c + ((Size_T)(p + q)) * ldl];
+								x[q] = b + ib + ((Size_T)(p + q)) * ldb;
+							}
+							Axpy4(a, x, bc, mi);
+						}
+						for( ; p < pe; ++p )
+						{
+							Axpy(-l[c + ((Size_T)p) * ldl], b + ib + ((Size_T)p) * ldb, bc, mi);
+						}
+						if( pb == cb )
+						{
+							T r = T(1.0) / l[c + ((Size_T)c) * ldl];
+							for( int i = 0; i < mi; ++i )
+							{
+								bc[i] *= r;
+							}
+						}
+					}
+				}
+			}
+		});
+	}
+
+	template<typename T>
+	void SpdKernels<T>::SyrkLower(int m, int k, const T* a, int lda, T* c, int ldc, ThreadPool* pool)
+	{
+	// C -= A * A^T for the lower triangle of the m x m column-major C, A is m x k column-major
+	// Column blocks are independent
+		ForEach(pool, (m + TileSize - 1) / TileSize, [&](int t)
+		{
+			int jb = t * TileSize;
+			int je = std::min(jb + TileSize, m);
+			for( int ib = jb; ib < m; ib += TileSize )
+			{
+				int ie = std::min(ib + TileSize, m);
+				for( int j = jb; j < je; ++j )
+				{
+					int i0 = std::max(ib, j);
+					T* cj = c + ((Size_T)j) * ldc;
+					int p = 0;
+					for( ; p + 3 < k; p += 4 )
+					{
+						T s[4];
+						const T* x[4];
+						for( int q = 0; q < 4; ++q )
+						{
+							const T* ap = a + ((Size_T)(p + q)) * lda;
+							s[q] = -ap[j];
+							x[q] = ap + i0;
+						}
+						Axpy4(s, x, cj + i0, ie - i0);
+					}
+					for( ; p < k; ++p )
+					{
+						const T* ap = a + ((Size_T)p) * lda;
+						Axpy(-ap[j], ap + i0, cj + i0, ie - i0);
+					}
+				}
+			}
+		});
+	}
+
+	template<typename T>
+	void SpdKernels<T>::SyrkRows(int m, int k, const T* a, int lda, T* const* rows, ThreadPool* pool)
+	{
+	// C -= A * A^T for the row-oriented m x m lower triangle C, A is m x k column-major
+	// The update is tiled over rows, columns and the inner dimension, so a TileSize x TileSize block of A stays in cache
+	// Row blocks are independent, they are taken from the last (the longest) one
+		int nt = (m + TileSize - 1) / TileSize;
+		ForEach(pool, nt, [&](int t)
+		{
+			int ib = (nt - 1 - t) * TileSize;
+			int ie = std::min(ib + TileSize, m);
+			for( int pb = 0; pb < k; pb += TileSize )
+			{
+				int pe = std::min(pb + TileSize, k);
+				for( int jb = 0; jb <= ib; jb += TileSize )
+				{
+					int je = std::min(jb + TileSize, m);
+					for( int i = ib; i < ie; ++i )
+					{
+						int j1 = std::min(je, i + 1);
+						int p = pb;
+						for( ; p + 3 < pe; p += 4 )
+						{
+							T s[4];
+							const T* x[4];
+							for( int q = 0; q < 4; ++q )
+							{
+								const T* ap = a + ((Size_T)(p + q)) * lda;
+								s[q] = -ap[i];
+								x[q] = ap + jb;
+							}
+							Axpy4(s, x, rows[i] + jb, j1 - jb);
+						}
+						for( ; p < pe; ++p )
+						{
+							const T* ap = a + ((Size_T)p) * lda;
+							Axpy(-ap[i], ap + jb, rows[i] + jb, j1 - jb);
+						}
+					}
+				}
+			}
+		});
+	}
+
+	template<typename T>
+	void SpdKernels<T>::SolveCols(int n1, int n, const T* a, int lda, T* w, int k, int nb)
+	{
+	// Solves L11 * X1 = W1 and updates W2 -= L21 * X1, where [L11; L21] is the n x n1 column-major lower trapezoid a,
+	// W is n x k row-major
+		for( int jb = 0; jb < n1; jb += nb )
+		{
+			int je = std::min(jb + nb, n1);
+			for( int j = jb; j < je; ++j )
+			{
+				const T* aj = a + ((Size_T)j) * lda;
+				T* wj = w + ((Size_T)j) * k;
+				T r = T(1.0) / aj[j];
+				for( int c = 0; c < k; ++c )
+				{
+					wj[c] *= r;
+				}
+				for( int i = j + 1; i < je; ++i )
+				{
+					Axpy(-aj[i], wj, w + ((Size_T)i) * k, k);
+				}
+			}
+
+			for( int ib = je; ib < n; ib += nb )
+			{
+				int ie = std::min(ib + nb, n);
+				for( int j = jb; j < je; ++j )
+				{
+					const T* aj = a + ((Size_T)j) * lda;
+					const T* wj = w + ((Size_T)j) * k;
+					for( int i = ib; i < ie; ++i )
+					{
+						Axpy(-aj[i], wj, w + ((Size_T)i) * k, k);
+					}
+				}
+			}
+		}
+	}
+
+	template<typename T>
+	void SpdKernels<T>::SolveColsTrans(int n1, int n, const T* a, int lda, T* w, int k, int nb)
+	{
+	// Solves L11^T * X1 = W1 - L21^T * X2, where [L11; L21] is the n x n1 column-major lower trapezoid a,
+	// W is n x k row-major, its rows n1..n-1 hold X2
+		for( int jb = ((n1 - 1) / nb) * nb; jb >= 0; jb -= nb )
+		{
+			int je = std::min(jb + nb, n1);
+			for( int ib = je; ib < n; ib += nb )
+			{
+				int ie = std::min(ib + nb, n);
+				for( int j = jb; j < je; ++j )
+				{
+					const T* aj = a + ((Size_T)j) * lda;
+					T* wj = w + ((Size_T)j) * k;
+					for( int i = ib; i < ie; ++i )
+					{
+						Axpy(-aj[i], w + ((Size_T)i) * k, wj, k);
+					}
+				}
+			}
+
+			for( int j = je - 1; j >= jb; --j )
+			{
+				const T* aj = a + ((Size_T)j) * lda;
+				T* wj = w + ((Size_T)j) * k;
+				for( int i = j + 1; i < je; ++i )
+				{
+					Axpy(-aj[i], w + ((Size_T)i) * k, wj, k);
+				}
+				T r = T(1.0) / aj[j];
+				for( int c = 0; c < k; ++c )
+				{
+					wj[c] *= r;
+				}
+			}
+		}
+	}
+
+} // end of mns namespace
+
+#endif // __SPDKERNELS_H__
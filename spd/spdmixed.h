@@ -0,0 +1,269 @@
+/* 
+*************************************************************
+Copyright  2013 Igor Kohanovsky e-mail: Igor.Kohanovsky@gmail.com
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*************************************************************
+*/
+#pragma once
+#ifndef __SPDMIXED_H__
+#define __SPDMIXED_H__
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include "ispd.h"
+#include "spdchol.h"
+#include "../helper/helper1.h"
+
+namespace mns
+{
+	template <typename T, typename L = float>
+	class SpdMixed : public ISpd<T>
+	{
+	// Solves the system of linear equations with symmetric positive-definite matrix by the Cholesky factor computed
+	// in the lower precision L and iterative refinement in T: x += L^-T * L^-1 * (b - A * x), the residual is computed
+	// by IHelper<T>::GetResidual. The factor takes half of the memory (and of the memory traffic) of the T factor.
+	// Refinement converges when cond(A) * eps(L) < 1, so Factorize() falls back to the factorization in T if
+	// the low precision one fails or its GetRCond() is below GetMinRCond(); IsMixed() tells which one is used.
+	// Solve() stops when ||b - A * x|| <= sqrt(n) * eps(T) * ||A||_F * ||x|| (as LAPACK dsgesv does), the number of
+	// iterations and the residual norm of the last solution are reported by GetIterations() and GetResidualNorm();
+	// the solution by the factor in T counts as one iteration. GetRCond() is an estimate, so refinement may still
+	// stall (the residual does not decrease) or reach GetMaxIterations(): then, as in dsgesv, A is factorized in T
+	// once, the solution is computed by this factor and the following solutions use it, IsMixed() becomes false.
+	// The matrix A is kept in T for the residuals, it is not overwritten by the factor. The work vectors of Solve() are
+	// kept between the solutions, so the repeated solutions do not allocate heap memory. Hence an object must not be
+	// used by several threads at once, even by its const methods.
+	public:
+		typedef typename ISpd<T>::VectorT VectorT;
+		typedef typename ISpd<T>::SpdMatrixT SpdMatrixT;
+		typedef typename SpdChol<L>::VectorT VectorL;
+		typedef typename SpdChol<L>::SpdMatrixT SpdMatrixL;
+
+		SpdMixed(SpdMatrixT&& spdMatrixT, int n) : m_(std::move(spdMatrixT)), helper_(&ownHelper_), minRCond_(T(DefaultMinRCond)), maxIterations_(DefaultMaxIterations), numThreads_(1), anorm_(T(0.0)), iterations_(0), residual_(T(0.0)) { this->n_ = n; this->isFactorized_ = false; this->cond_ = T(0.0); };
+		const SpdMatrixT& GetMatrix() const { return m_; };
+		const IHelper<T>& GetHelper() const { return *helper_; };
+		void SetHelper(const IHelper<T>* helper) { helper_ = ( helper != nullptr ) ? helper : &ownHelper_; }; // nullptr means the own Helper1, a shared helper must not be used by two solutions at once
+		T    GetMinRCond() const { return minRCond_; };
+		void SetMinRCond(T minRCond) { minRCond_ = minRCond; };
+		int  GetMaxIterations() const { return maxIterations_; };
+		void SetMaxIterations(int maxIterations) { maxIterations_ = ( maxIterations > 0 ) ? maxIterations : DefaultMaxIterations; };
+		int  GetNumThreads() const { return numThreads_; };
+		void SetNumThreads(int numThreads);
+		bool IsMixed() const { return low_ != nullptr; };  // the factor in L is used
+		int  GetIterations() const { return iterations_; }; // of the last solution
+		T    GetResidualNorm() const { return residual_; }; // ||b - A * x||_2 of the last solution
+		~SpdMixed() {};
+
+		static const int DefaultMaxIterations = 30;
+		static const double DefaultMinRCond;
+	private:
+		// Interface implementation
+		virtual Status FactorizeImpl() override;
+		virtual Status SolveImpl(VectorT& b) const override;
+		virtual T	   GetRCondImpl() const override;
+		virtual T	   GetRCondEstimateImpl() const override;
+		Status FactorizeHigh() const;
+		Status SolveHigh(VectorT& b) const;
+		SpdMatrixT m_;
+		mutable std::unique_ptr<SpdChol<L>> low_;  // nullptr if the factorization in T is used, Solve() may switch to it
+		mutable std::unique_ptr<SpdChol<T>> high_;
+		Helper1<T> ownHelper_;
+		const IHelper<T>* helper_;
+		T minRCond_;
+		int maxIterations_;
+		int numThreads_;
+		T anorm_;
+		mutable int iterations_;
+		mutable T residual_;
+		mutable VectorT x_; // work vectors of Solve()
+		mutable VectorT r_;
+		mutable VectorL d_;
+	};
+
+	template<typename T, typename L>
+	const double SpdMixed<T, L>::DefaultMinRCond = 1.0e-5; // cond(A) * eps(float) <= 0.012
+
+	template<typename T, typename L>
+	void SpdMixed<T, L>::SetNumThreads(int numThreads)
+	{
+	// Sets the number of threads of factorization and solution, numThreads <= 0 means the number of processors
+		numThreads_ = ( numThreads > 0 ) ? numThreads : ThreadPool::GetNumProcs();
+		if( low_ )
+		{
+			low_->SetNumThreads(numThreads_);
+		}
+		if( high_ )
+		{
+			high_->SetNumThreads(numThreads_);
+		}
+	}
+
+	template<typename T, typename L>
+	Status SpdMixed<T, L>::FactorizeImpl()
+	{
+	// Factorizes the copy of A rounded to L, falls back to the copy in T if it is too ill-conditioned for refinement
+		if( this->IsFactorized() )
+		{
+			return Status::Success;
+		}
+
+		int n = this->n_;
+		Size_T size = ((Size_T)n) * (n + 1) / 2;
+		if( n <= 0 || m_.size() < size )
+		{
+			return Status::BadParameter;
+		}
+
+		T s = T(0.0);
+		for( int i = 0; i < n; ++i )
+		{
+			const T* mi = m_.data() + ((Size_T)i) * (i + 1) / 2;
+			for( int j = 0; j < i; ++j )
+			{
+				s += T(2.0) * mi[j] * mi[j];
+			}
+			s += mi[i] * mi[i];
+		}
+		anorm_ = std::sqrt(s);
+
+		SpdMatrixL a(size);
+		for( Size_T k = 0; k < size; ++k )
+		{
+			a[k] = (L)m_[k];
+		}
+		low_.reset(new SpdChol<L>(std::move(a), n));
+		low_->SetNumThreads(numThreads_);
+		if( low_->Factorize() == Status::Success && low_->GetRCond() >= minRCond_ )
+		{
+			high_.reset();
+			this->isFactorized_ = true;
+			return Status::Success;
+		}
+
+		low_.reset();
+		Status status = FactorizeHigh();
+		this->isFactorized_ = ( status == Status::Success );
+		return status;
+	}
+
+	template<typename T, typename L>
+	Status SpdMixed<T, L>::FactorizeHigh() const
+	{
+	// Factorizes the copy of A in T, the solution is not refined; the factor in L is dropped only if it succeeds
+		std::unique_ptr<SpdChol<T>> high(new SpdChol<T>(SpdMatrixT(m_), this->n_));
+		high->SetNumThreads(numThreads_);
+		Status status = high->Factorize();
+		if( status == Status::Success )
+		{
+			high_ = std::move(high);
+			low_.reset();
+		}
+		return status;
+	}
+
+	template<typename T, typename L>
+	Status SpdMixed<T, L>::SolveHigh(VectorT& b) const
+	{
+	// b is replaced by the solution by the factor in T, the residual is computed for GetResidualNorm()
+		int n = this->n_;
+		x_.assign(b.begin(), b.begin() + n);
+		Status status = high_->Solve(b);
+		if( status == Status::Success )
+		{
+			helper_->GetResidual(n, m_, b, x_, r_);
+			residual_ = helper_->GetVectorNorm2(n, r_);
+			++iterations_;
+		}
+		return status;
+	}
+
+	template<typename T, typename L>
+	T SpdMixed<T, L>::GetRCondImpl() const
+	{
+		if( !this->isFactorized_ )
+		{
+			return T(0.0);
+		}
+		return low_ ? (T)low_->GetRCond() : high_->GetRCond();
+	}
+
+	template<typename T, typename L>
+	T SpdMixed<T, L>::GetRCondEstimateImpl() const
+	{
+		if( !this->isFactorized_ )
+		{
+			return T(0.0);
+		}
+		return low_ ? (T)low_->GetRCondEstimate() : high_->GetRCondEstimate();
+	}
+
+	template<typename T, typename L>
+	Status SpdMixed<T, L>::SolveImpl(VectorT& b) const
+	{
+	// b is replaced by the solution, the initial guess is zero
+		int n = this->n_;
+		if( !this->isFactorized_ )
+		{
+			return Status::Failure;
+		}
+		if( b.size() < (Size_T)n )
+		{
+			return Status::BadParameter;
+		}
+
+		iterations_ = 0;
+		residual_ = T(0.0);
+		if( !low_ )
+		{
+			return SolveHigh(b);
+		}
+
+		x_.assign(n, T(0.0));
+		r_.assign(b.begin(), b.begin() + n);
+		d_.resize(n);
+		T tol = std::sqrt(T(n)) * std::numeric_limits<T>::epsilon() * anorm_;
+		residual_ = helper_->GetVectorNorm2(n, r_);
+		Status status = Status::IterationLimit;
+		for( int it = 1; it <= maxIterations_ && residual_ > T(0.0); ++it )
+		{
+			T previous = residual_;
+			for( int i = 0; i < n; ++i )
+			{
+				d_[i] = (L)r_[i];
+			}
+			low_->Solve(d_);
+			for( int i = 0; i < n; ++i )
+			{
+				x_[i] += d_[i];
+			}
+			helper_->GetResidual(n, m_, x_, b, r_);
+			residual_ = helper_->GetVectorNorm2(n, r_);
+			iterations_ = it;
+			if( residual_ <= tol * helper_->GetVectorNorm2(n, x_) )
+			{
+				status = Status::Success;
+				break;
+			}
+			if( !(residual_ < previous) )
+			{
+				break; // stalls or diverges (NaN included)
+			}
+		}
+		if( residual_ == T(0.0) )
+		{
+			status = Status::Success;
+		}
+		if( status != Status::Success && FactorizeHigh() == Status::Success )
+		{
+			return SolveHigh(b);
+		}
+		std::copy(x_.begin(), x_.end(), b.begin());
+		return status;
+	}
+
+} // end of mns namespace
+
+#endif // __SPDMIXED_H__
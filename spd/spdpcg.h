@@ -0,0 +1,230 @@
+/* 
+*************************************************************
+Copyright  2013 Igor Kohanovsky e-mail: Igor.Kohanovsky@gmail.com
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*************************************************************
+*/
+#pragma once
+#ifndef __SPDPCG_H__
+#define __SPDPCG_H__
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include "ispd.h"
+#include "spdkernels.h"
+#include "../common/arena.h"
+#include "../common/reduction.h"
+#include "../helper/spmv.h"
+#include "../service/threadpool.h"
+
+namespace mns
+{
+	template <typename T>
+	class SpdPcg : public ISpd<T>
+	{
+	// Solves the system of linear equations with symmetric positive-definite matrix by the preconditioned conjugate gradient method
+	// The matrix is kept in the row-packed layout. Factorize() sets up the block-Jacobi preconditioner: the diagonal blocks
+	// of the size GetBlockSize() are factorized by Cholesky, their factors take at most n * nb elements. Solve() iterates
+	// until ||b - A * x|| <= tol * ||b|| and returns Status::IterationLimit if the tolerance is not reached in maxIterations.
+	// The matrix-vector product (SpMv<T>) and the preconditioner run on numThreads threads, see SetNumThreads().
+	// The iterates do not depend on the number of threads: the product has SpMv<T>::GetNumParts(n) parts whatever
+	// the number, and the dot products are the ones of Reduction<T>.
+	// The work vectors (O(n) and the accumulators of the threaded product) are taken from an arena, as in SpdChol.
+	public:
+		typedef typename ISpd<T>::VectorT VectorT;
+		typedef typename ISpd<T>::SpdMatrixT SpdMatrixT;
+
+		SpdPcg(SpdMatrixT&& spdMatrixT, int n) : m_(std::move(spdMatrixT)), nb_(DefaultBlockSize), tol_(T(DefaultTolerance)), maxIterations_(0), numThreads_(1), iterations_(0), residual_(T(0.0)), arena_(&ownArena_) { this->n_ = n; this->isFactorized_ = false; this->cond_ = T(0.0); };
+		const SpdMatrixT& GetMatrix() const { return m_; };
+		int  GetBlockSize() const { return nb_; };
+		void SetBlockSize(int nb) { nb_ = ( nb > 0 ) ? nb : DefaultBlockSize; this->isFactorized_ = false; };
+		T    GetTolerance() const { return tol_; };
+		void SetTolerance(T tol) { tol_ = ( tol > T(0.0) ) ? tol : T(DefaultTolerance); };
+		int  GetMaxIterations() const { return ( maxIterations_ > 0 ) ? maxIterations_ : std::max(100, this->n_); };
+		void SetMaxIterations(int maxIterations) { maxIterations_ = maxIterations; }; // <= 0 means max(100, n)
+		int  GetNumThreads() const { return numThreads_; };
+		void SetNumThreads(int numThreads);
+		int  GetIterations() const { return iterations_; };   // of the last solution
+		T    GetResidual() const { return residual_; };       // ||b - A * x|| / ||b|| of the last solution
+		Arena& GetArena() const { return *arena_; };
+		void SetArena(Arena* arena) { arena_ = ( arena != nullptr ) ? arena : &ownArena_; }; // nullptr means the own arena
+		~SpdPcg() {};
+
+		static const int DefaultBlockSize = 64;
+		static const double DefaultTolerance;
+	private:
+		// Interface implementation
+		virtual Status FactorizeImpl() override;
+		virtual Status SolveImpl(VectorT& b) const override;
+		void   Multiply(const T* x, T* y) const;
+		void   Precondition(const T* r, T* z) const;
+		Size_T GetBlockOffset(int ib) const { return ((Size_T)ib) * nb_; }; // the blocks before ib hold ib * nb elements
+		SpdMatrixT m_;
+		VectorT prec_;  // Cholesky factors of the diagonal blocks, column-major
+		int nb_;
+		T tol_;
+		int maxIterations_;
+		int numThreads_;
+		mutable int iterations_;
+		mutable T residual_;
+		std::unique_ptr<ThreadPool> pool_; // nullptr for numThreads_ == 1
+		mutable Arena ownArena_;
+		Arena* arena_;
+	};
+
+	template<typename T>
+	const double SpdPcg<T>::DefaultTolerance = 1.0e-10;
+
+	template<typename T>
+	void SpdPcg<T>::SetNumThreads(int numThreads)
+	{
+	// Sets the number of threads of the product and the preconditioner, numThreads <= 0 means the number of processors
+		if( numThreads <= 0 )
+		{
+			numThreads = ThreadPool::GetNumProcs();
+		}
+		if( numThreads == numThreads_ )
+		{
+			return;
+		}
+
+		numThreads_ = numThreads;
+		pool_.reset(( numThreads > 1 ) ? new ThreadPool(numThreads) : nullptr);
+	}
+
+	template<typename T>
+	Status SpdPcg<T>::FactorizeImpl()
+	{
+	// Factorizes the diagonal blocks A(ib:ie, ib:ie), ie - ib <= nb
+		int n = this->n_;
+		if( n <= 0 || m_.size() < ((Size_T)n) * (n + 1) / 2 )
+		{
+			return Status::BadParameter;
+		}
+
+		prec_.resize(((Size_T)n) * nb_);
+		int numBlocks = (n + nb_ - 1) / nb_;
+		std::atomic<bool> failed(false);
+		SpdKernels<T>::ForEach(pool_.get(), numBlocks, [&](int t)
+		{
+			int ib = t * nb_;
+			int bs = std::min(nb_, n - ib);
+			T* a = prec_.data() + GetBlockOffset(ib);
+			for( int j = 0; j < bs; ++j )
+			{
+				for( int i = j; i < bs; ++i )
+				{
+					int r = ib + i;
+					a[((Size_T)j) * bs + i] = m_[((Size_T)r) * (r + 1) / 2 + ib + j];
+				}
+			}
+			if( SpdKernels<T>::FactorizeLowerUnblocked(bs, a, bs) != Status::Success )
+			{
+				failed = true;
+			}
+		});
+		this->isFactorized_ = !failed;
+		return failed ? Status::IllConditionedMatrix : Status::Success;
+	}
+
+	template<typename T>
+	void SpdPcg<T>::Multiply(const T* x, T* y) const
+	{
+	// y = A * x, the rows are split into parts of equal work multiplied into their own accumulators
+	// The number of parts depends on n only (SpMv<T>::GetNumParts), so the iterates do not depend on the number of threads
+		int n = this->n_;
+		int parts = SpMv<T>::GetNumParts(n);
+		if( parts <= 1 )
+		{
+			SpMv<T>::Multiply(n, m_.data(), x, y);
+			return;
+		}
+
+		ThreadPool* pool = pool_.get();
+		SpMv<T>::MultiplyParallel(n, m_.data(), x, nullptr, y, *arena_, [pool](int count, const std::function<void(int)>& body) { SpdKernels<T>::ForEach(pool, count, body); });
+	}
+
+	template<typename T>
+	void SpdPcg<T>::Precondition(const T* r, T* z) const
+	{
+	// z = M^-1 * r, M is the block diagonal of A
+		int n = this->n_;
+		SpdKernels<T>::ForEach(pool_.get(), (n + nb_ - 1) / nb_, [&](int t)
+		{
+			int ib = t * nb_;
+			int bs = std::min(nb_, n - ib);
+			const T* a = prec_.data() + GetBlockOffset(ib);
+			std::copy(r + ib, r + ib + bs, z + ib);
+			SpdKernels<T>::SolveCols(bs, bs, a, bs, z + ib, 1, bs);
+			SpdKernels<T>::SolveColsTrans(bs, bs, a, bs, z + ib, 1, bs);
+		});
+	}
+
+	template<typename T>
+	Status SpdPcg<T>::SolveImpl(VectorT& b) const
+	{
+	// b is replaced by the solution, the initial guess is zero
+		int n = this->n_;
+		if( !this->isFactorized_ )
+		{
+			return Status::Failure;
+		}
+		if( b.size() < (Size_T)n )
+		{
+			return Status::BadParameter;
+		}
+
+		ArenaScope scope(*arena_);
+		T* x = b.data();
+		T* r = arena_->Allocate<T>(n);
+		T* z = arena_->Allocate<T>(n);
+		T* p = arena_->Allocate<T>(n);
+		T* q = arena_->Allocate<T>(n);
+		std::copy(x, x + n, r);
+		std::fill(x, x + n, T(0.0));
+
+		T normB = std::sqrt(Reduction<T>::Dot(r, r, n, Accumulation::Pairwise, pool_.get()));
+		iterations_ = 0;
+		residual_ = T(0.0);
+		if( normB == T(0.0) )
+		{
+			return Status::Success;
+		}
+
+		Precondition(r, z);
+		std::copy(z, z + n, p);
+		T rz = Reduction<T>::Dot(r, z, n, Accumulation::Pairwise, pool_.get());
+		int maxIterations = GetMaxIterations();
+		for( int it = 1; it <= maxIterations; ++it )
+		{
+			Multiply(p, q);
+			T alpha = rz / Reduction<T>::Dot(p, q, n, Accumulation::Pairwise, pool_.get());
+			Simd<T>::Axpy(alpha, p, x, n);
+			Simd<T>::Axpy(-alpha, q, r, n);
+			iterations_ = it;
+			residual_ = std::sqrt(Reduction<T>::Dot(r, r, n, Accumulation::Pairwise, pool_.get())) / normB;
+			if( residual_ <= tol_ )
+			{
+				return Status::Success;
+			}
+
+			Precondition(r, z);
+			T rzNew = Reduction<T>::Dot(r, z, n, Accumulation::Pairwise, pool_.get());
+			T beta = rzNew / rz;
+			rz = rzNew;
+			for( int i = 0; i < n; ++i )
+			{
+				p[i] = z[i] + beta * p[i];
+			}
+		}
+		return Status::IterationLimit;
+	}
+
+} // end of MNS namespace
+
+#endif // __SPDPCG_H__
@@ -0,0 +1,335 @@
+/* 
+*************************************************************
+Copyright  2013 Igor Kohanovsky e-mail: Igor.Kohanovsky@gmail.com
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*************************************************************
+*/
+#pragma once
+#ifndef __GREEDY_H__
+#define __GREEDY_H__
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+#include "../common/simd.h"
+#include "../rk/gram.h"
+#include "../spd/spdchol.h"
+#include "../service/threadpool.h"
+
+namespace mns
+{
+	template <typename T, int Dims>
+	class Greedy final
+	{
+	// Greedy selection of the interpolation nodes out of n candidates, the kernel interpolant of the m selected nodes
+	// is kept in the Newton basis: N_k(x) = (V(x, s_k) - sum of L(k,j) * N_j(x), j < k) / L(k,k), L is the Cholesky
+	// factor of the Gram matrix of the selected nodes s_0..s_{m-1}. A step appends the column of the new node to the
+	// factor by SpdChol::UpdateAdd (the values of the Newton basis at the new node are the new row of L), computes
+	// the new basis function at all the candidates and updates the residual r = f - sigma and the squared power function
+	// P^2(x) = V(x, x) - sum of N_k(x)^2, so a step costs O(n * m) and the factor is never recomputed.
+	// The next node maximizes |r| (Selection::Residual), P (Selection::Power) or |r| / P (Selection::ResidualPower).
+	// The kernel coefficients of the interpolant are given by GetCoefficients(), the factor by GetSolver().
+	public:
+		typedef typename Defs<T, Dims>::VectorT VectorT;
+		typedef typename Defs<T, Dims>::VectorP VectorP;
+		typedef typename Defs<T, Dims>::SpdMatrixT SpdMatrixT;
+
+		enum class Selection : unsigned int
+		{
+			Residual = 0x0,     // f-greedy
+			Power = 0x1,        // P-greedy, does not depend on the values
+			ResidualPower = 0x2 // f/P-greedy
+		};
+
+		explicit Greedy(const IRK<T>& rk, Selection selection = Selection::Residual) : rk_(rk), selection_(selection), n_(0), numThreads_(1), v0_(T(0.0)) {};
+
+		Status Init(const VectorP& nodes, const VectorT& values);
+		Status Step();
+		Status Run(T tol, int maxNodes = 0); // maxNodes <= 0 means all the candidates
+
+		const std::vector<int>& GetSelected() const { return selected_; }; // the candidates in the order of selection
+		int  GetNumSelected() const { return (int)selected_.size(); };
+		const VectorT& GetResidual() const { return r_; };                // at the candidates, 0 at the selected ones
+		const VectorT& GetPower2() const { return p2_; };                 // squared power function at the candidates
+		T    GetMaxResidual() const;
+		Status GetCoefficients(VectorT& mu) const; // mu[k] is the coefficient of V(x, s_k)
+		const SpdChol<T>* GetSolver() const { return chol_.get(); };  // the factor of the Gram matrix of the selected nodes
+		Selection GetSelection() const { return selection_; };
+		void SetSelection(Selection selection) { selection_ = selection; };
+		int  GetNumThreads() const { return numThreads_; };
+		void SetNumThreads(int numThreads);
+
+		static const int Chunk = 1024; // candidates processed together by a thread
+	private:
+		int  GetNext() const;
+		void AddBasis(int k, const T* l);
+
+		const IRK<T>& rk_;
+		Selection selection_;
+		int n_;
+		int numThreads_;
+		std::unique_ptr<ThreadPool> pool_; // nullptr for numThreads_ == 1
+		T v0_;                             // V(x, x)
+		VectorT soa_;                      // coordinate k of candidate j is soa_[k * n + j]
+		VectorT f_;
+		VectorT r_;
+		VectorT p2_;
+		VectorT basis_;                    // N_k(x_j) is basis_[k * n + j]
+		std::vector<int> selected_;
+		std::vector<bool> excluded_;       // selected or rejected as ill-conditioned
+		std::unique_ptr<SpdChol<T>> chol_;
+
+		Greedy(const Greedy&);
+		Greedy& operator =(const Greedy&);
+	};
+
+	template<typename T, int Dims>
+	void Greedy<T, Dims>::SetNumThreads(int numThreads)
+	{
+	// Sets the number of threads of the basis update, numThreads <= 0 means the number of processors
+		if( numThreads <= 0 )
+		{
+			numThreads = ThreadPool::GetNumProcs();
+		}
+		if( chol_ )
+		{
+			chol_->SetNumThreads(numThreads);
+		}
+		if( numThreads == numThreads_ )
+		{
+			return;
+		}
+
+		numThreads_ = numThreads;
+		pool_.reset(( numThreads > 1 ) ? new ThreadPool(numThreads) : nullptr);
+	}
+
+	template<typename T, int Dims>
+	Status Greedy<T, Dims>::Init(const VectorP& nodes, const VectorT& values)
+	{
+	// Sets the candidates, nothing is selected
+		int n = (int)nodes.size();
+		if( n == 0 || values.size() != nodes.size() )
+		{
+			return Status::BadParameter;
+		}
+
+		n_ = n;
+		soa_.resize(((Size_T)Dims) * n);
+		Gram<T, Dims>::ToSoA(nodes, n, soa_.data());
+		f_.assign(values.begin(), values.end());
+		r_ = f_;
+		v0_ = rk_.GetValue(T(0.0));
+		p2_.assign(n, v0_);
+		basis_.clear();
+		selected_.clear();
+		excluded_.assign(n, false);
+		chol_.reset(new SpdChol<T>(SpdMatrixT(), 0));
+		chol_->SetNumThreads(numThreads_);
+		return chol_->Factorize();
+	}
+
+	template<typename T, int Dims>
+	T Greedy<T, Dims>::GetMaxResidual() const
+	{
+		T rmax = T(0.0);
+		for( int i = 0; i < n_; ++i )
+		{
+			rmax = std::max(rmax, std::abs(r_[i]));
+		}
+		return rmax;
+	}
+
+	template<typename T, int Dims>
+	int Greedy<T, Dims>::GetNext() const
+	{
+	// Returns the candidate maximizing the selection criterion, -1 if there is none
+	// The candidates with P^2 at the rounding level of V(x, x) are skipped, their basis functions are not defined
+		T p2min = T(16.0) * std::numeric_limits<T>::epsilon() * v0_;
+		int next = -1;
+		T best = T(0.0);
+		for( int i = 0; i < n_; ++i )
+		{
+			if( excluded_[i] || p2_[i] <= p2min )
+			{
+				continue;
+			}
+			T c;
+			switch( selection_ )
+			{
+			case Selection::Power:
+				c = p2_[i];
+				break;
+			case Selection::ResidualPower:
+				c = r_[i] * r_[i] / p2_[i];
+				break;
+			default:
+				c = std::abs(r_[i]);
+				break;
+			}
+			if( next < 0 || c > best )
+			{
+				next = i;
+				best = c;
+			}
+		}
+		return next;
+	}
+
+	template<typename T, int Dims>
+	Status Greedy<T, Dims>::Step()
+	{
+	// Selects one more node, returns Status::Failure if no candidate is left
+		if( !chol_ )
+		{
+			return Status::Failure;
+		}
+		int next = GetNext();
+		if( next < 0 )
+		{
+			return Status::Failure;
+		}
+
+		// The column of the Gram matrix: V(x_next, s_j) = the new basis column before the orthogonalization
+		int m = (int)selected_.size();
+		int n = n_;
+		VectorT v(n);
+		T q[Dims];
+		for( int k = 0; k < Dims; ++k )
+		{
+			q[k] = soa_[((Size_T)k) * n + next];
+		}
+		Simd<T>::Distance(soa_.data(), n, Dims, q, v.data(), n);
+		rk_.GetValues(v.data(), v.data(), n);
+
+		VectorT d(m + 1);
+		for( int j = 0; j < m; ++j )
+		{
+			d[j] = v[selected_[j]];
+		}
+		d[m] = v0_;
+		Status status = chol_->UpdateAdd(d);
+		excluded_[next] = true;
+		if( status != Status::Success )
+		{
+			return status;
+		}
+
+		// d is the new row of L, d[j] = N_j(x_next), d[m] = P(x_next)
+		basis_.resize(((Size_T)(m + 1)) * n);
+		std::copy(v.begin(), v.end(), basis_.begin() + ((Size_T)m) * n);
+		selected_.push_back(next);
+		AddBasis(next, d.data());
+		return Status::Success;
+	}
+
+	template<typename T, int Dims>
+	void Greedy<T, Dims>::AddBasis(int next, const T* l)
+	{
+	// Orthogonalizes the last column of basis_ (the kernel values) against the previous ones, l is the new row of L,
+	// then updates the residual and the power function, the candidates are processed by chunks on the threads
+		int n = n_;
+		int m = (int)selected_.size() - 1;
+		T* nm = basis_.data() + ((Size_T)m) * n;
+		T c = r_[next] / l[m];
+		auto update = [&](int ib, int ie)
+		{
+			int len = ie - ib;
+			int j = 0;
+			for( ; j + 4 <= m; j += 4 )
+			{
+				T a[4] = { -l[j], -l[j + 1], -l[j + 2], -l[j + 3] };
+				const T* x[4];
+				for( int t = 0; t < 4; ++t )
+				{
+					x[t] = basis_.data() + ((Size_T)(j + t)) * n + ib;
+				}
+				Simd<T>::Axpy4(a, x, nm + ib, len);
+			}
+			for( ; j < m; ++j )
+			{
+				Simd<T>::Axpy(-l[j], basis_.data() + ((Size_T)j) * n + ib, nm + ib, len);
+			}
+			T scale = T(1.0) / l[m];
+			for( int i = ib; i < ie; ++i )
+			{
+				nm[i] *= scale;
+				r_[i] -= c * nm[i];
+				p2_[i] -= nm[i] * nm[i];
+			}
+		};
+
+		int numChunks = (n + Chunk - 1) / Chunk;
+		if( pool_ == nullptr || numChunks <= 1 )
+		{
+			update(0, n);
+		}
+		else
+		{
+			pool_->ParallelFor(0, numChunks, 1, [&](int lo, int hi)
+			{
+				update(lo * Chunk, std::min(n, hi * Chunk));
+			});
+		}
+		r_[next] = T(0.0);
+		p2_[next] = T(0.0);
+	}
+
+	template<typename T, int Dims>
+	Status Greedy<T, Dims>::Run(T tol, int maxNodes)
+	{
+	// Selects the nodes until max |r| <= tol (or max P^2 <= tol for Selection::Power) or maxNodes are selected
+	// A candidate rejected by UpdateAdd as ill-conditioned is skipped. Returns Status::IterationLimit if the tolerance
+	// is not reached.
+		if( !chol_ )
+		{
+			return Status::Failure;
+		}
+		if( maxNodes <= 0 || maxNodes > n_ )
+		{
+			maxNodes = n_;
+		}
+
+		while( true )
+		{
+			T err = ( selection_ == Selection::Power ) ? *std::max_element(p2_.begin(), p2_.end()) : GetMaxResidual();
+			if( err <= tol )
+			{
+				return Status::Success;
+			}
+			if( (int)selected_.size() >= maxNodes )
+			{
+				return Status::IterationLimit;
+			}
+			Status status = Step();
+			if( status == Status::Failure )
+			{
+				return Status::IterationLimit;
+			}
+		}
+	}
+
+	template<typename T, int Dims>
+	Status Greedy<T, Dims>::GetCoefficients(VectorT& mu) const
+	{
+	// mu = G^-1 * f(s), the interpolant is sigma(x) = sum of mu[k] * V(x, s_k)
+		if( !chol_ )
+		{
+			return Status::Failure;
+		}
+		int m = (int)selected_.size();
+		mu.resize(m);
+		for( int k = 0; k < m; ++k )
+		{
+			mu[k] = f_[selected_[k]];
+		}
+		return ( m > 0 ) ? chol_->Solve(mu) : Status::Success;
+	}
+
+} // end of mns namespace
+
+#endif // __GREEDY_H__
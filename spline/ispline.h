@@ -14,17 +14,31 @@ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLI
 
 namespace mns 
 {
-	template <typename T>
+	template <typename T, int Dims>
 	class ISpline
 	{
 	// Defines interface for calculating normal splines
+	// Build() fits the spline to the values at the nodes, Evaluate() computes it at the query points
 	public:
-		typedef typename std::array<T, N> ArrayT;
-		typedef typename Defs<T>::VectorT VectorT;
+		typedef typename std::array<T, Dims> ArrayT;
+		typedef typename Defs<T, Dims>::VectorT VectorT;
+		typedef typename Defs<T, Dims>::VectorP VectorP;
+
+		Status Build(const VectorP& nodes, const VectorT& values) { return BuildImpl(nodes, values); };
+		T      Evaluate(const Point<T, Dims>& x) const { T s; EvaluateImpl(&x, 1, &s); return s; };
+		void   Evaluate(const Point<T, Dims>* x, int count, T* s) const { EvaluateImpl(x, count, s); };
+		void   Evaluate(const VectorP& x, VectorT& s) const { s.resize(x.size()); EvaluateImpl(x.data(), (int)x.size(), s.data()); };
+
+		int    GetNumNodes() const { return n_; };
 
 		virtual ~ISpline() {};
 	protected:
-		ISpline() {};
+		virtual Status BuildImpl(const VectorP& nodes, const VectorT& values) = 0;
+		virtual void   EvaluateImpl(const Point<T, Dims>* x, int count, T* s) const = 0;
+
+		ISpline() : n_(0) {};
+
+		int n_;
 	private:
     	ISpline(const ISpline&);
 		ISpline& operator =(const ISpline&);
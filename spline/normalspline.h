@@ -0,0 +1,278 @@
+/* 
+*************************************************************
+Copyright  2013 Igor Kohanovsky e-mail: Igor.Kohanovsky@gmail.com
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and associated documentation files (the "Software"), to deal in the Software without restriction, including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, subject to the following conditions:
+The above copyright notice and this permission notice shall be included in all copies or substantial portions of the Software.
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*************************************************************
+*/
+#pragma once
+#ifndef __NORMALSPLINE_H__
+#define __NORMALSPLINE_H__
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include "ispline.h"
+#include "../common/kdtree.h"
+#include "../common/simd.h"
+#include "../rk/gram.h"
+#include "../spd/spdchol.h"
+#include "../service/threadpool.h"
+
+namespace mns
+{
+	template <typename T, int Dims>
+	class NormalSpline : public ISpline<T, Dims>
+	{
+	// Normal spline interpolating the values at the nodes: sigma(x) = sum of mu[i] * V(x, x_i), V is the reproducing kernel,
+	// mu is the solution of the Gram system G * mu = f (the Gram matrix is assembled by Gram and factorized by SpdChol)
+	// Evaluation is tiled: a tile of QueryTile query points is evaluated against a tile of NodeTile nodes (their coordinates
+	// in the structure-of-arrays layout and their coefficients) which stays in L1 while it is used by all the queries
+	// of the tile. The query tiles are evaluated on numThreads threads, see SetNumThreads().
+	//
+	// Truncated evaluation (SetTruncation): the kernel decreases with the distance, so the nodes farther than the cutoff
+	// distance d_c, V(d_c) = tol * V(0), are skipped. The nodes are kept in the order of a k-d tree and a query visits
+	// only the leaves whose boxes are within d_c, hence the cost of a query does not grow with n for a fixed node density.
+	// The skipped terms are bounded by V(d_c) * ||mu||_1 <= tol * V(0) * ||mu||_1, see GetErrorBound().
+	public:
+		typedef typename ISpline<T, Dims>::VectorT VectorT;
+		typedef typename ISpline<T, Dims>::VectorP VectorP;
+		typedef typename Defs<T, Dims>::SpdMatrixT SpdMatrixT;
+
+		explicit NormalSpline(const IRK<T>& rk) : rk_(rk), gram_(rk), numThreads_(1), tol_(T(0.0)), cutoff_(T(0.0)), muNorm1_(T(0.0)) {};
+
+		const VectorT& GetCoefficients() const { return mu_; };
+		const SpdChol<T>* GetSolver() const { return chol_.get(); }; // nullptr before Build()
+		int  GetNumThreads() const { return numThreads_; };
+		void SetNumThreads(int numThreads);
+		T    GetTruncation() const { return tol_; };
+		void SetTruncation(T tol); // tol <= 0 turns truncation off
+		T    GetCutoff() const { return cutoff_; };
+		T    GetErrorBound() const;
+
+		static const int NodeTile = 512;  // (Dims + 1) * NodeTile elements are kept in L1
+		static const int QueryTile = 64;
+	protected:
+		virtual Status BuildImpl(const VectorP& nodes, const VectorT& values) override;
+		virtual void   EvaluateImpl(const Point<T, Dims>* x, int count, T* s) const override;
+	private:
+		void EvaluateTile(const Point<T, Dims>* x, int count, T* s) const;
+		void EvaluateTruncated(const Point<T, Dims>* x, int count, T* s) const;
+		void PrepareTruncation();
+
+		const IRK<T>& rk_;
+		Gram<T, Dims> gram_;
+		std::unique_ptr<SpdChol<T>> chol_;
+		int numThreads_;
+		std::unique_ptr<ThreadPool> pool_; // nullptr for numThreads_ == 1
+		VectorT soa_;                      // coordinate k of node j is soa_[k * n + j]
+		VectorT mu_;
+		T tol_;
+		T cutoff_;
+		T muNorm1_;
+		KdTree<T, Dims> tree_;
+		VectorT treeSoa_; // the nodes and the coefficients in the order of the tree
+		VectorT treeMu_;
+	};
+
+	template<typename T, int Dims>
+	void NormalSpline<T, Dims>::SetNumThreads(int numThreads)
+	{
+	// Sets the number of threads of assembly, factorization and evaluation, numThreads <= 0 means the number of processors
+		if( numThreads <= 0 )
+		{
+			numThreads = ThreadPool::GetNumProcs();
+		}
+		gram_.SetNumThreads(numThreads);
+		if( chol_ )
+		{
+			chol_->SetNumThreads(numThreads);
+		}
+		if( numThreads == numThreads_ )
+		{
+			return;
+		}
+
+		numThreads_ = numThreads;
+		pool_.reset(( numThreads > 1 ) ? new ThreadPool(numThreads) : nullptr);
+	}
+
+	template<typename T, int Dims>
+	Status NormalSpline<T, Dims>::BuildImpl(const VectorP& nodes, const VectorT& values)
+	{
+		int n = (int)nodes.size();
+		if( n == 0 || values.size() != nodes.size() )
+		{
+			return Status::BadParameter;
+		}
+
+		SpdMatrixT a;
+		Status status = gram_.Assemble(nodes, a);
+		if( status != Status::Success )
+		{
+			return status;
+		}
+		chol_.reset(new SpdChol<T>(std::move(a), n));
+		chol_->SetNumThreads(numThreads_);
+		status = chol_->Factorize();
+		if( status != Status::Success )
+		{
+			return status;
+		}
+		mu_.assign(values.begin(), values.end());
+		status = chol_->Solve(mu_);
+		if( status != Status::Success )
+		{
+			return status;
+		}
+
+		soa_.resize(((Size_T)Dims) * n);
+		Gram<T, Dims>::ToSoA(nodes, n, soa_.data());
+		this->n_ = n;
+		muNorm1_ = T(0.0);
+		for( int i = 0; i < n; ++i )
+		{
+			muNorm1_ += std::abs(mu_[i]);
+		}
+		PrepareTruncation();
+		return Status::Success;
+	}
+
+	template<typename T, int Dims>
+	void NormalSpline<T, Dims>::SetTruncation(T tol)
+	{
+	// Sets the relative cutoff of the kernel, the nodes with V(x, x_i) <= tol * V(0) are skipped
+		tol_ = ( tol > T(0.0) ) ? tol : T(0.0);
+		PrepareTruncation();
+	}
+
+	template<typename T, int Dims>
+	T NormalSpline<T, Dims>::GetErrorBound() const
+	{
+	// Returns the bound of |sigma(x) - truncated sigma(x)|, 0 if there is no truncation
+		return ( tol_ > T(0.0) ) ? rk_.GetValue(cutoff_) * muNorm1_ : T(0.0);
+	}
+
+	template<typename T, int Dims>
+	void NormalSpline<T, Dims>::PrepareTruncation()
+	{
+	// Finds the cutoff distance by bisection and builds the tree of the nodes
+		int n = this->n_;
+		if( tol_ <= T(0.0) || n == 0 )
+		{
+			cutoff_ = T(0.0);
+			return;
+		}
+
+		T v = tol_ * rk_.GetValue(T(0.0));
+		T lo = T(0.0);
+		T hi = T(1.0) / rk_.GetEps();
+		while( rk_.GetValue(hi) > v )
+		{
+			lo = hi;
+			hi *= T(2.0);
+		}
+		for( int it = 0; it < 64 && hi - lo > hi * std::numeric_limits<T>::epsilon(); ++it )
+		{
+			T mid = (lo + hi) / T(2.0);
+			if( rk_.GetValue(mid) > v )
+			{
+				lo = mid;
+			}
+			else
+			{
+				hi = mid;
+			}
+		}
+		cutoff_ = hi;
+
+		tree_.Build(soa_.data(), n, n, std::min((int)KdTree<T, Dims>::DefaultLeafSize, (int)NodeTile));
+		const std::vector<int>& index = tree_.GetIndex();
+		treeSoa_.resize(soa_.size());
+		treeMu_.resize(n);
+		for( int j = 0; j < n; ++j )
+		{
+			for( int k = 0; k < Dims; ++k )
+			{
+				treeSoa_[((Size_T)k) * n + j] = soa_[((Size_T)k) * n + index[j]];
+			}
+			treeMu_[j] = mu_[index[j]];
+		}
+	}
+
+	template<typename T, int Dims>
+	void NormalSpline<T, Dims>::EvaluateImpl(const Point<T, Dims>* x, int count, T* s) const
+	{
+		auto evaluate = [&](int qb, int qe)
+		{
+			if( tol_ > T(0.0) )
+			{
+				EvaluateTruncated(x + qb, qe - qb, s + qb);
+			}
+			else
+			{
+				EvaluateTile(x + qb, qe - qb, s + qb);
+			}
+		};
+
+		int numTiles = (count + QueryTile - 1) / QueryTile;
+		if( pool_ == nullptr || numTiles <= 1 )
+		{
+			evaluate(0, count);
+			return;
+		}
+
+		pool_->ParallelFor(0, numTiles, 1, [&](int lo, int hi)
+		{
+			evaluate(lo * QueryTile, std::min(count, hi * QueryTile));
+		});
+	}
+
+	template<typename T, int Dims>
+	void NormalSpline<T, Dims>::EvaluateTruncated(const Point<T, Dims>* x, int count, T* s) const
+	{
+	// s[q] = sigma(x[q]) over the leaves of the tree within the cutoff distance
+		int n = this->n_;
+		T v[NodeTile];
+		for( int q = 0; q < count; ++q )
+		{
+			const T* xq = x[q].p.data();
+			T sq = T(0.0);
+			tree_.ForEachLeaf(xq, cutoff_, [&](int jb, int je)
+			{
+				Simd<T>::Distance(treeSoa_.data() + jb, n, Dims, xq, v, je - jb);
+				rk_.GetValues(v, v, je - jb);
+				sq += Simd<T>::Dot(v, treeMu_.data() + jb, je - jb);
+			});
+			s[q] = sq;
+		}
+	}
+
+	template<typename T, int Dims>
+	void NormalSpline<T, Dims>::EvaluateTile(const Point<T, Dims>* x, int count, T* s) const
+	{
+	// s[q] = sigma(x[q]), the queries are taken by QueryTile, the nodes by NodeTile
+		int n = this->n_;
+		std::fill(s, s + count, T(0.0));
+		T v[NodeTile];
+		for( int qb = 0; qb < count; qb += QueryTile )
+		{
+			int qe = std::min(count, qb + QueryTile);
+			for( int jb = 0; jb < n; jb += NodeTile )
+			{
+				int m = std::min((int)NodeTile, n - jb);
+				for( int q = qb; q < qe; ++q )
+				{
+					Simd<T>::Distance(soa_.data() + jb, n, Dims, x[q].p.data(), v, m);
+					rk_.GetValues(v, v, m);
+					s[q] += Simd<T>::Dot(v, mu_.data() + jb, m);
+				}
+			}
+		}
+	}
+
+} // end of mns namespace
+
+#endif // __NORMALSPLINE_H__
@@ -6,29 +6,31 @@ The above copyright notice and this permission notice shall be included in all c
 THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 *************************************************************
 */
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <iomanip>
-
+#include <limits>
 #include <memory>
 #include <random>
+#include <string>
+#include <vector>
 
 #include "../service/stopwatch.h"
+#include "../service/probe.h"
 #include "../rk/rk.h"
+#include "../rk/gram.h"
 #include "../spd/spdchol.h"
-#include "../helper/helper1.h"
-
-#define OPENMP
-//#define AMP
-#ifdef PPL
-#include "../helper/helper1ppl.h"
-#endif
-#ifdef OPENMP
-#include "../helper/helper1omp.h"
-#endif
-#ifdef AMP
-#include "../helper/helper1amp.h"
-#else
-#endif
+#include "../spd/spdmixed.h"
+#include "../spd/spdpcg.h"
+#include "../rk/hmatrix.h"
+#include "../spline/normalspline.h"
+#include "../spline/greedy.h"
+#include "../helper/helpers.h"
 
 using std::cin;
 using std::cout;
@@ -46,22 +48,1133 @@ std::ostream& operator << (std::ostream& os, const mns::Status& obj)
 
 typedef Helper1<double> Helper1T;
 
+// Benchmark suite
+// Every operation is run `repeats` times on a fresh copy of its input and the best time is reported, together with
+// the rate of the nominal flops and of the minimal memory traffic (the packed triangle is read once per pass).
+// The results go to the console and, if requested, to CSV and JSON files, so the runs of different commits can be compared:
+//   test [-n 256,512,1024] [-r repeats] [-t threads] [-k updates] [-h serial,pool,omp] [-w workers] [-pin] [-csv file] [-json file] [-tag label] [-nowait]
+// The helper backends are all the ones compiled in (see Helpers<T>) unless they are listed by -h.
+// -w and -pin configure the shared Scheduler (the default is a worker per processor but one, not pinned).
+//
+// Check mode (-check) runs the solvers, the splines and the H-matrix on small problems instead of the benchmarks and
+// compares their results with dense references computed in double, the exit code is the number of failed checks:
+//   test -check [-t threads] [-w workers] [-pin] [-nowait]
+struct BenchOptions
+{
+	std::vector<int> sizes;
+	int repeats;
+	int numThreads; // of SpdChol, <= 0 means the number of processors
+	int updates;    // rows added by UpdateAdd and deleted by UpdateDel
+	std::vector<HelperKind> helpers;
+	int workers;    // of the Scheduler, < 0 means the number of processors - 1
+	bool pinned;
+	std::string csv;
+	std::string json;
+	std::string tag;
+	bool check;
+	bool wait;
+};
+
+struct BenchResult
+{
+	std::string type;
+	std::string matrix;
+	std::string helper;
+	std::string op;
+	int n;
+	double seconds; // the best of the repeats, per call
+	double flops;   // per call, 0 if it is not defined
+	double bytes;   // per call
+	Status status;
+};
+
+bool ParseOptions(int argc, char* argv[], BenchOptions& opt);
+template <typename T>
+void RunBenchmarks(const BenchOptions& opt, const char* type, std::vector<BenchResult>& results);
+void PrintResult(const BenchResult& r);
+bool WriteCsv(const std::string& file, const std::vector<BenchResult>& results);
+bool WriteJson(const std::string& file, const std::string& tag, const std::vector<BenchResult>& results);
+template <typename T>
+int  RunChecks(const BenchOptions& opt, const char* type);
+int  RunThreadPoolCheck();
+
 int main(int argc, char* argv[])
 {
+	BenchOptions opt;
+	if( !ParseOptions(argc, argv, opt) )
+	{
+		cout << "Usage: test [-n 256,512,1024] [-r repeats] [-t threads] [-k updates] [-h serial,pool,omp] [-w workers] [-pin] [-csv file] [-json file] [-tag label] [-nowait]" << endl;
+		cout << "       test -check [-t threads] [-w workers] [-pin] [-nowait]" << endl;
+		return 1;
+	}
+	Scheduler::Configure(opt.workers, opt.pinned);
+
+	if( opt.check )
+	{
+		cout << std::left << std::setw(7) << "type" << std::setw(22) << "check" << std::setw(7) << "n" << std::right << std::setw(12) << "error" << std::setw(12) << "tolerance" << "  result" << endl;
+		int failed = RunThreadPoolCheck() + RunChecks<float>(opt, "float") + RunChecks<double>(opt, "double");
+		cout << endl << ( failed == 0 ? "All checks passed" : "Some checks FAILED" ) << endl;
+		if( opt.wait )
+		{
+			cout << endl << "Hit <Return> key to exit..." << endl;
+			cin.clear();
+			cin.ignore(cin.rdbuf()->in_avail());
+			cin.get();
+		}
+		return failed;
+	}
+
+	std::vector<BenchResult> results;
+	cout << std::left << std::setw(7) << "type" << std::setw(8) << "matrix" << std::setw(7) << "n" << std::setw(9) << "helper"
+		 << std::setw(16) << "op" << std::right << std::setw(12) << "time, ms" << std::setw(10) << "GFLOP/s" << std::setw(10) << "GB/s" << std::setw(8) << "status" << endl;
+	RunBenchmarks<float>(opt, "float", results);
+	RunBenchmarks<double>(opt, "double", results);
+
+#ifdef MNS_PROBES
+	cout << endl << "Probes:" << endl;
+	Probes::Print(cout);
+#endif
 
+	if( !opt.csv.empty() && !WriteCsv(opt.csv, results) )
+	{
+		cout << "Cannot write " << opt.csv << endl;
+	}
+	if( !opt.json.empty() && !WriteJson(opt.json, opt.tag, results) )
+	{
+		cout << "Cannot write " << opt.json << endl;
+	}
 
-	cout << endl << "Hit <Return> key to exit..." << endl;
-	cin.clear();
-	cin.ignore(cin.rdbuf()->in_avail());
-	cin.get();
+	if( opt.wait )
+	{
+		cout << endl << "Hit <Return> key to exit..." << endl;
+		cin.clear();
+		cin.ignore(cin.rdbuf()->in_avail());
+		cin.get();
+	}
 	return 0;
 }
 
+bool ParseOptions(int argc, char* argv[], BenchOptions& opt)
+{
+	opt.repeats = 3;
+	opt.numThreads = 1;
+	opt.updates = 16;
+	opt.workers = -1;
+	opt.pinned = false;
+	opt.check = false;
+	opt.wait = true;
+	for( int i = 1; i < argc; ++i )
+	{
+		std::string arg(argv[i]);
+		bool hasValue = ( i + 1 < argc );
+		if( arg == "-nowait" )
+		{
+			opt.wait = false;
+		}
+		else if( arg == "-check" )
+		{
+			opt.check = true;
+		}
+		else if( arg == "-n" && hasValue )
+		{
+			std::string list(argv[++i]);
+			for( size_t pos = 0; pos < list.size(); )
+			{
+				size_t next = list.find(',', pos);
+				if( next == std::string::npos )
+				{
+					next = list.size();
+				}
+				int n = std::atoi(list.substr(pos, next - pos).c_str());
+				if( n <= 0 )
+				{
+					return false;
+				}
+				opt.sizes.push_back(n);
+				pos = next + 1;
+			}
+		}
+		else if( arg == "-r" && hasValue )
+		{
+			opt.repeats = std::max(1, std::atoi(argv[++i]));
+		}
+		else if( arg == "-t" && hasValue )
+		{
+			opt.numThreads = std::atoi(argv[++i]);
+		}
+		else if( arg == "-w" && hasValue )
+		{
+			opt.workers = std::max(0, std::atoi(argv[++i]));
+		}
+		else if( arg == "-pin" )
+		{
+			opt.pinned = true;
+		}
+		else if( arg == "-k" && hasValue )
+		{
+			opt.updates = std::max(1, std::atoi(argv[++i]));
+		}
+		else if( arg == "-h" && hasValue )
+		{
+			std::string list(argv[++i]);
+			for( size_t pos = 0; pos < list.size(); )
+			{
+				size_t next = list.find(',', pos);
+				if( next == std::string::npos )
+				{
+					next = list.size();
+				}
+				HelperKind kind;
+				if( !Helpers<double>::GetKind(list.substr(pos, next - pos), kind) || !Helpers<double>::IsAvailable(kind) )
+				{
+					return false;
+				}
+				opt.helpers.push_back(kind);
+				pos = next + 1;
+			}
+		}
+		else if( arg == "-csv" && hasValue )
+		{
+			opt.csv = argv[++i];
+		}
+		else if( arg == "-json" && hasValue )
+		{
+			opt.json = argv[++i];
+		}
+		else if( arg == "-tag" && hasValue )
+		{
+			opt.tag = argv[++i];
+		}
+		else
+		{
+			return false;
+		}
+	}
+	if( opt.sizes.empty() )
+	{
+		opt.sizes.push_back(256);
+		opt.sizes.push_back(512);
+		opt.sizes.push_back(1024);
+		opt.sizes.push_back(2048);
+	}
+	if( opt.helpers.empty() )
+	{
+		for( int k = 0; k < (int)HelperKind::Count; ++k )
+		{
+			if( Helpers<double>::IsAvailable((HelperKind)k) )
+			{
+				opt.helpers.push_back((HelperKind)k);
+			}
+		}
+	}
+	return true;
+}
+
+template <typename S, typename F>
+double TimeBest(int repeats, S setup, F run)
+{
+// Returns the best time of run() in seconds, setup() prepares the input of every repeat and is not timed
+	double best = std::numeric_limits<double>::max();
+	for( int k = 0; k < repeats; ++k )
+	{
+		setup();
+		StopWatch sw;
+		run();
+		best = std::min(best, 1.0e-6 * sw.ElapsedUs().count());
+	}
+	return best;
+}
+
+template <typename T>
+void MakeRandomSpd(int n, std::mt19937& g, typename Defs<T>::SpdMatrixT& a)
+{
+// Diagonally dominant matrix with random off-diagonal elements in [-1, 1]
+	std::uniform_real_distribution<T> u(T(-1.0), T(1.0));
+	a.resize(((Size_T)n) * (n + 1) / 2);
+	for( int i = 0; i < n; ++i )
+	{
+		Size_T ii = ((Size_T)i) * (i + 1) / 2;
+		for( int j = 0; j < i; ++j )
+		{
+			a[ii + j] = u(g);
+		}
+		a[ii + i] = T(n);
+	}
+}
+
+const int GramDims = 3;
+
+template <typename T>
+void MakeNodes(int n, std::mt19937& g, typename Defs<T, GramDims>::VectorP& nodes)
+{
+// n random nodes in the unit cube
+	std::uniform_real_distribution<T> u(T(0.0), T(1.0));
+	nodes.resize(n);
+	for( int i = 0; i < n; ++i )
+	{
+		for( int k = 0; k < GramDims; ++k )
+		{
+			nodes[i].p[k] = u(g);
+		}
+	}
+}
+
+template <typename T>
+T GetGramEps(int n)
+{
+// eps of the RK which keeps eps * h about 4 for n nodes in the unit cube
+	return T(4.0 * std::pow((double)n, 1.0 / GramDims));
+}
+
+template <typename T>
+void MakeGram(int n, std::mt19937& g, typename Defs<T>::SpdMatrixT& a)
+{
+// Gram matrix of the RK of smoothness 2 for n random nodes in the unit cube
+	typename Defs<T, GramDims>::VectorP nodes;
+	MakeNodes<T>(n, g, nodes);
+	RK<T> rk(2, GetGramEps<T>(n));
+	Gram<T, GramDims> gram(rk);
+	gram.Assemble(nodes, a);
+}
+
+template <typename T>
+void BenchMatrix(const BenchOptions& opt, const char* type, const char* matrix, int n, const typename Defs<T>::SpdMatrixT& a0, std::vector<BenchResult>& results)
+{
+// Runs the solver operations and the helper operations for the matrix a0
+	typedef typename Defs<T>::SpdMatrixT SpdMatrixT;
+	typedef typename Defs<T>::VectorT VectorT;
+	const double packed = ((double)n) * (n + 1) / 2 * sizeof(T);
+	std::mt19937 g(7);
+	std::uniform_real_distribution<T> u(T(-1.0), T(1.0));
+	VectorT b0(n);
+	for( int i = 0; i < n; ++i )
+	{
+		b0[i] = u(g);
+	}
+
+	BenchResult r;
+	r.type = type;
+	r.matrix = matrix;
+	r.n = n;
+	r.helper = "-";
+
+	// Factorize
+	std::unique_ptr<SpdChol<T>> chol;
+	Status status = Status::Success;
+	r.op = "Factorize";
+	r.seconds = TimeBest(opt.repeats, [&]() { chol.reset(new SpdChol<T>(SpdMatrixT(a0), n)); chol->SetNumThreads(opt.numThreads); }, [&]() { status = chol->Factorize(); });
+	r.flops = ((double)n) * n * n / 3.0;
+	r.bytes = 2.0 * packed;
+	r.status = status;
+	results.push_back(r);
+	PrintResult(r);
+	if( status != Status::Success )
+	{
+		return;
+	}
+
+	// Solve, GetRCond with the factor of the last repeat
+	VectorT b;
+	r.op = "Solve";
+	r.seconds = TimeBest(opt.repeats, [&]() { b = b0; }, [&]() { status = chol->Solve(b); });
+	r.flops = 2.0 * n * n;
+	r.bytes = 2.0 * packed;
+	r.status = status;
+	results.push_back(r);
+	PrintResult(r);
+
+	T rcond = T(0.0);
+	r.op = "GetRCond";
+	r.seconds = TimeBest(opt.repeats, [&]() {}, [&]() { rcond = chol->GetRCond(); });
+	r.flops = 0.0; // the number of iterations of the estimator varies
+	r.bytes = 0.0;
+	r.status = ( rcond > T(0.0) ) ? Status::Success : Status::Failure;
+	results.push_back(r);
+	PrintResult(r);
+
+	// UpdateAdd: the last k rows are added one by one to the factor of the leading n - k rows
+	int k = std::min(opt.updates, n - 1);
+	int m = n - k;
+	std::vector<VectorT> columns(k);
+	double flops = 0.0, bytes = 0.0;
+	for( int c = 0; c < k; ++c )
+	{
+		int i = m + c;
+		flops += ((double)i) * i;
+		bytes += ((double)i) * (i + 1) / 2 * sizeof(T);
+	}
+	r.op = "UpdateAdd";
+	r.seconds = TimeBest(opt.repeats, [&]()
+	{
+		chol.reset(new SpdChol<T>(SpdMatrixT(a0.begin(), a0.begin() + ((Size_T)m) * (m + 1) / 2), m));
+		chol->SetNumThreads(opt.numThreads);
+		chol->Factorize();
+		for( int c = 0; c < k; ++c )
+		{
+			Size_T ii = ((Size_T)(m + c)) * (m + c + 1) / 2;
+			columns[c].assign(a0.begin() + ii, a0.begin() + ii + m + c + 1);
+		}
+	}, [&]()
+	{
+		for( int c = 0; c < k && status == Status::Success; ++c )
+		{
+			status = chol->UpdateAdd(columns[c]);
+		}
+	});
+	r.seconds /= k;
+	r.flops = flops / k;
+	r.bytes = bytes / k;
+	r.status = status;
+	results.push_back(r);
+	PrintResult(r);
+
+	// UpdateDel: k rows are deleted one by one from the middle of the factor
+	flops = bytes = 0.0;
+	for( int c = 0; c < k; ++c )
+	{
+		double rows = (n - c) - (n - c) / 2;
+		flops += 3.0 * rows * rows;
+		bytes += 2.0 * rows * (n - c) * sizeof(T);
+	}
+	r.op = "UpdateDel";
+	status = Status::Success;
+	r.seconds = TimeBest(opt.repeats, [&]()
+	{
+		chol.reset(new SpdChol<T>(SpdMatrixT(a0), n));
+		chol->SetNumThreads(opt.numThreads);
+		chol->Factorize();
+	}, [&]()
+	{
+		for( int c = 0; c < k && status == Status::Success; ++c )
+		{
+			status = chol->UpdateDel(chol->GetMatrixDim() / 2);
+		}
+	});
+	r.seconds /= k;
+	r.flops = flops / k;
+	r.bytes = bytes / k;
+	r.status = status;
+	results.push_back(r);
+	PrintResult(r);
+
+	// Helper backends
+	VectorT x(b0), res;
+	for( size_t h = 0; h < opt.helpers.size(); ++h )
+	{
+		std::unique_ptr<IHelper<T>> pHelper = Helpers<T>::Create(opt.helpers[h]);
+		const IHelper<T>& helper = *pHelper;
+		r.helper = Helpers<T>::GetName(opt.helpers[h]);
+		r.status = Status::Success;
+
+		r.op = "GetResidual";
+		r.seconds = TimeBest(opt.repeats, [&]() {}, [&]() { helper.GetResidual(n, a0, x, b0, res); });
+		r.flops = 2.0 * n * n;
+		r.bytes = packed;
+		results.push_back(r);
+		PrintResult(r);
+
+		// A vector norm takes microseconds, so it is timed over many calls
+		const int calls = std::max(1, (1 << 24) / n);
+		volatile T norm = T(0.0);
+		r.op = "GetVectorNorm2";
+		r.seconds = TimeBest(opt.repeats, [&]() {}, [&]()
+		{
+			for( int c = 0; c < calls; ++c )
+			{
+				norm = helper.GetVectorNorm2(n, x);
+			}
+		}) / calls;
+		r.flops = 2.0 * n;
+		r.bytes = ((double)n) * sizeof(T);
+		results.push_back(r);
+		PrintResult(r);
+	}
+}
+
+template <typename T>
+void RunBenchmarks(const BenchOptions& opt, const char* type, std::vector<BenchResult>& results)
+{
+// Sweeps the sizes for both kinds of matrices, the matrices depend on the seed only, so runs are reproducible
+	for( size_t s = 0; s < opt.sizes.size(); ++s )
+	{
+		int n = opt.sizes[s];
+		std::mt19937 g(n);
+		typename Defs<T>::SpdMatrixT a;
+		MakeRandomSpd<T>(n, g, a);
+		BenchMatrix<T>(opt, type, "random", n, a, results);
+		MakeGram<T>(n, g, a);
+		BenchMatrix<T>(opt, type, "gram", n, a, results);
+	}
+}
+
+// Check mode
+
+template <typename T>
+void MultiplyDense(int n, const typename Defs<T>::SpdMatrixT& a, const T* x, std::vector<double>& y)
+{
+// y = A * x in double, a is the packed lower triangle of A
+	y.assign(n, 0.0);
+	for( int i = 0; i < n; ++i )
+	{
+		const T* ai = a.data() + ((Size_T)i) * (i + 1) / 2;
+		double s = 0.0;
+		for( int j = 0; j < i; ++j )
+		{
+			s += (double)ai[j] * x[j];
+			y[j] += (double)ai[j] * x[i];
+		}
+		y[i] += s + (double)ai[i] * x[i];
+	}
+}
+
+template <typename T>
+double GetNormInf(int n, const typename Defs<T>::SpdMatrixT& a)
+{
+// ||A||_inf of the packed lower triangle of A
+	std::vector<double> s(n, 0.0);
+	for( int i = 0; i < n; ++i )
+	{
+		const T* ai = a.data() + ((Size_T)i) * (i + 1) / 2;
+		for( int j = 0; j < i; ++j )
+		{
+			s[i] += std::abs((double)ai[j]);
+			s[j] += std::abs((double)ai[j]);
+		}
+		s[i] += std::abs((double)ai[i]);
+	}
+	return *std::max_element(s.begin(), s.end());
+}
+
+template <typename T>
+double GetError(int n, const typename Defs<T>::SpdMatrixT& a, const T* x, const T* b, const T* ax)
+{
+// ||b - A * x||_inf / (||A||_inf * ||x||_inf + ||b||_inf), the normwise backward error of the solution x of A * x = b
+// ax is A * x computed by the code under check, nullptr means the dense product in double
+	std::vector<double> y;
+	if( ax == nullptr )
+	{
+		MultiplyDense<T>(n, a, x, y);
+	}
+	else
+	{
+		y.assign(ax, ax + n);
+	}
+	double r = 0.0, xn = 0.0, bn = 0.0;
+	for( int i = 0; i < n; ++i )
+	{
+		r = std::max(r, std::abs(b[i] - y[i]));
+		xn = std::max(xn, std::abs((double)x[i]));
+		bn = std::max(bn, std::abs((double)b[i]));
+	}
+	return r / (GetNormInf<T>(n, a) * xn + bn);
+}
+
+template <typename T>
+double GetRelativeResidual(int n, const typename Defs<T>::SpdMatrixT& a, const T* x, const T* b)
+{
+// ||b - A * x||_2 / ||b||_2 in double
+	std::vector<double> y;
+	MultiplyDense<T>(n, a, x, y);
+	double r = 0.0, bn = 0.0;
+	for( int i = 0; i < n; ++i )
+	{
+		r += (b[i] - y[i]) * (b[i] - y[i]);
+		bn += (double)b[i] * b[i];
+	}
+	return std::sqrt(r / bn);
+}
+
+template <typename T>
+void DeleteRows(int n, const typename Defs<T>::SpdMatrixT& a, const std::vector<bool>& deleted, typename Defs<T>::SpdMatrixT& ar)
+{
+// ar is the packed lower triangle of A without the deleted rows and columns
+	ar.clear();
+	for( int i = 0; i < n; ++i )
+	{
+		if( deleted[i] )
+		{
+			continue;
+		}
+		const T* ai = a.data() + ((Size_T)i) * (i + 1) / 2;
+		for( int j = 0; j <= i; ++j )
+		{
+			if( !deleted[j] )
+			{
+				ar.push_back(ai[j]);
+			}
+		}
+	}
+}
+
+template <typename T>
+double GetRCond2(int n, const typename Defs<T>::SpdMatrixT& a, const SpdChol<T>& chol)
+{
+// lambda_min / lambda_max of A by the power iterations with A and with the inverse of A (the solutions by chol of A)
+	const int iterations = 100;
+	const T v0 = T(1.0 / std::sqrt((double)n));
+	typename Defs<T>::VectorT v(n, v0), w;
+	std::vector<double> y;
+	double lmax = 0.0, lmin = 0.0;
+	for( int it = 0; it < iterations; ++it )
+	{
+		MultiplyDense<T>(n, a, v.data(), y);
+		double s = 0.0;
+		for( int i = 0; i < n; ++i )
+		{
+			s += y[i] * y[i];
+		}
+		lmax = std::sqrt(s);
+		for( int i = 0; i < n; ++i )
+		{
+			v[i] = T(y[i] / lmax);
+		}
+	}
+	v.assign(n, v0);
+	for( int it = 0; it < iterations; ++it )
+	{
+		w = v;
+		chol.Solve(w);
+		double s = 0.0;
+		for( int i = 0; i < n; ++i )
+		{
+			s += (double)w[i] * w[i];
+		}
+		lmin = 1.0 / std::sqrt(s);
+		for( int i = 0; i < n; ++i )
+		{
+			v[i] = T(w[i] * lmin);
+		}
+	}
+	return lmin / lmax;
+}
+
+bool PrintCheck(const char* type, const char* check, int n, double error, double tol)
+{
+// A failed status is reported as the infinite error, NaN fails too
+	bool ok = ( error <= tol );
+	cout << std::left << std::setw(7) << type << std::setw(22) << check << std::setw(7) << n << std::right;
+	cout.setf(std::ios::scientific, std::ios::floatfield);
+	cout.precision(2);
+	cout << std::setw(12) << error << std::setw(12) << tol << "  " << ( ok ? "OK" : "FAIL" ) << endl;
+	return ok;
+}
+
+int RunThreadPoolCheck()
+{
+// A binary tree of tasks, every task submits its children, is run by ThreadPool(2): the error is the largest number
+// of the tasks running at once, whatever the number of workers of the Scheduler
+	const int depth = 8;
+	ThreadPool pool(2);
+	std::atomic<int> running(0), peak(0), count(0);
+	std::function<void(int)> node = [&](int d)
+	{
+		int r = ++running;
+		for( int p = peak; r > p && !peak.compare_exchange_weak(p, r); )
+		{
+		}
+		volatile double s = 0.0;
+		for( int i = 0; i < 100000; ++i )
+		{
+			s += i;
+		}
+		++count;
+		--running;
+		if( d < depth )
+		{
+			pool.Submit([&node, d]() { node(d + 1); });
+			pool.Submit([&node, d]() { node(d + 1); });
+		}
+	};
+	pool.Submit([&node]() { node(0); });
+	pool.Wait();
+	bool ok = PrintCheck("-", "ThreadPool(2) DAG", count, ( count == (2 << depth) - 1 ) ? (double)peak : std::numeric_limits<double>::infinity(), 2.0);
+	return ok ? 0 : 1;
+}
+
+template <typename T>
+int RunChecks(const BenchOptions& opt, const char* type)
+{
+// Runs the checks in T against the dense references, returns the number of the failed ones
+	typedef typename Defs<T>::SpdMatrixT SpdMatrixT;
+	typedef typename Defs<T>::VectorT VectorT;
+	typedef typename Defs<T, GramDims>::VectorP VectorP;
+	const double eps = std::numeric_limits<T>::epsilon();
+	const double failure = std::numeric_limits<double>::infinity();
+	int failed = 0;
+
+	// Solvers, the random SPD matrix is well-conditioned, so the solutions agree up to the rounding
+	const int n = 500;
+	std::mt19937 g(n);
+	std::uniform_real_distribution<T> u(T(-1.0), T(1.0));
+	SpdMatrixT a;
+	MakeRandomSpd<T>(n, g, a);
+	VectorT b(n);
+	for( int i = 0; i < n; ++i )
+	{
+		b[i] = u(g);
+	}
+	const double tol = n * eps;
+
+	{
+		// Both layouts, a single right-hand side and a block of them; the error of the block is the largest of its columns
+		const int nrhs = 5;
+		VectorT block(((Size_T)n) * nrhs);
+		for( Size_T i = 0; i < block.size(); ++i )
+		{
+			block[i] = u(g);
+		}
+		const SpdLayout layouts[] = { SpdLayout::Packed, SpdLayout::Rfp };
+		const char* names[][2] = { { "Solve", "Solve(b, nrhs)" }, { "Solve RFP", "Solve(b, nrhs) RFP" } };
+		for( int l = 0; l < 2; ++l )
+		{
+			SpdChol<T> chol(SpdMatrixT(a), n);
+			chol.SetNumThreads(opt.numThreads);
+			chol.SetLayout(layouts[l]);
+			VectorT x(b), xb(block);
+			Status status = chol.Factorize();
+			if( status == Status::Success )
+			{
+				status = chol.Solve(x);
+			}
+			if( !PrintCheck(type, names[l][0], n, ( status == Status::Success ) ? GetError<T>(n, a, x.data(), b.data(), nullptr) : failure, tol) )
+			{
+				++failed;
+			}
+			double error = failure;
+			if( chol.IsFactorized() && chol.Solve(xb, nrhs) == Status::Success )
+			{
+				error = 0.0;
+				for( int c = 0; c < nrhs; ++c )
+				{
+					Size_T offset = ((Size_T)c) * n;
+					error = std::max(error, GetError<T>(n, a, xb.data() + offset, block.data() + offset, nullptr));
+				}
+			}
+			if( !PrintCheck(type, names[l][1], n, error, tol) )
+			{
+				++failed;
+			}
+		}
+	}
+
+	{
+		// The last k rows are added by a single UpdateAddBlock to the factor of the leading n - k rows
+		const int k = 32;
+		int m = n - k;
+		SpdChol<T> chol(SpdMatrixT(a.begin(), a.begin() + ((Size_T)m) * (m + 1) / 2), m);
+		chol.SetNumThreads(opt.numThreads);
+		VectorT block(((Size_T)n) * k, T(0.0));
+		for( int c = 0; c < k; ++c )
+		{
+			Size_T ii = ((Size_T)(m + c)) * (m + c + 1) / 2;
+			std::copy(a.begin() + ii, a.begin() + ii + m + c + 1, block.begin() + ((Size_T)c) * n);
+		}
+		VectorT x(b);
+		Status status = chol.Factorize();
+		if( status == Status::Success )
+		{
+			status = chol.UpdateAddBlock(block, k);
+		}
+		if( status == Status::Success )
+		{
+			status = chol.Solve(x);
+		}
+		if( !PrintCheck(type, "UpdateAddBlock", n, ( status == Status::Success ) ? GetError<T>(n, a, x.data(), b.data(), nullptr) : failure, tol) )
+		{
+			++failed;
+		}
+	}
+
+	{
+		// Scattered and adjacent rows, the first and the last ones are deleted by a single UpdateDel, the solution
+		// is compared with the one of the factor of the reduced matrix
+		std::vector<int> del;
+		for( int i = 0; i < n; i += 37 )
+		{
+			del.push_back(i);
+		}
+		del.push_back(n / 2);
+		del.push_back(n / 2 + 1);
+		del.push_back(n - 1);
+		std::vector<bool> deleted(n, false);
+		for( size_t d = 0; d < del.size(); ++d )
+		{
+			deleted[del[d]] = true;
+		}
+		SpdMatrixT ar;
+		DeleteRows<T>(n, a, deleted, ar);
+		VectorT br;
+		for( int i = 0; i < n; ++i )
+		{
+			if( !deleted[i] )
+			{
+				br.push_back(b[i]);
+			}
+		}
+		int nr = (int)br.size();
+
+		SpdChol<T> chol(SpdMatrixT(a), n);
+		chol.SetNumThreads(opt.numThreads);
+		SpdChol<T> ref(SpdMatrixT(ar), nr);
+		VectorT x(br), xr(br);
+		Status status = chol.Factorize();
+		if( status == Status::Success )
+		{
+			status = chol.UpdateDel(del);
+		}
+		if( status == Status::Success )
+		{
+			status = chol.Solve(x);
+		}
+		double error = failure;
+		if( status == Status::Success && chol.GetMatrixDim() == nr && ref.Factorize() == Status::Success && ref.Solve(xr) == Status::Success )
+		{
+			double d = 0.0, xn = 0.0;
+			for( int i = 0; i < nr; ++i )
+			{
+				d = std::max(d, std::abs((double)x[i] - xr[i]));
+				xn = std::max(xn, std::abs((double)xr[i]));
+			}
+			error = d / xn;
+		}
+		if( !PrintCheck(type, "UpdateDel(vector)", nr, error, tol) )
+		{
+			++failed;
+		}
+	}
+
+	{
+		// The true residual may drift from the recursive one of the iterations, hence the margin
+		SpdPcg<T> pcg(SpdMatrixT(a), n);
+		pcg.SetNumThreads(opt.numThreads);
+		pcg.SetTolerance(T(std::sqrt(eps)));
+		VectorT x(b);
+		Status status = pcg.Factorize();
+		if( status == Status::Success )
+		{
+			status = pcg.Solve(x);
+		}
+		if( !PrintCheck(type, "SpdPcg", n, ( status == Status::Success ) ? GetRelativeResidual<T>(n, a, x.data(), b.data()) : failure, 10.0 * std::sqrt(eps)) )
+		{
+			++failed;
+		}
+	}
+
+	{
+		SpdMixed<T> mixed(SpdMatrixT(a), n);
+		mixed.SetNumThreads(opt.numThreads);
+		VectorT x(b);
+		Status status = mixed.Factorize();
+		if( status == Status::Success )
+		{
+			status = mixed.Solve(x);
+		}
+		if( !PrintCheck(type, "SpdMixed", n, ( status == Status::Success ) ? GetError<T>(n, a, x.data(), b.data(), nullptr) : failure, tol) )
+		{
+			++failed;
+		}
+		// One refinement step does not reach the accuracy of T when L is coarser, the solution falls back to T
+		mixed.SetMaxIterations(1);
+		x = b;
+		status = mixed.Solve(x);
+		if( !PrintCheck(type, "SpdMixed fallback", n, ( status == Status::Success ) ? GetError<T>(n, a, x.data(), b.data(), nullptr) : failure, tol) )
+		{
+			++failed;
+		}
+	}
+
+	// Kernel methods on random nodes, the dense reference is the Gram matrix assembled by Gram
+	const int nn = 2000;
+	VectorP nodes;
+	MakeNodes<T>(nn, g, nodes);
+	VectorT f(nn);
+	for( int i = 0; i < nn; ++i )
+	{
+		f[i] = std::sin(T(3.0) * nodes[i].p[0]) + nodes[i].p[1] * nodes[i].p[2];
+	}
+	RK<T> rk(2, GetGramEps<T>(nn));
+	SpdMatrixT gram;
+	Gram<T, GramDims>(rk).Assemble(nodes, gram);
+
+	{
+		// The spline evaluated at the nodes against the values, the coefficients solve the Gram system
+		NormalSpline<T, GramDims> spline(rk);
+		spline.SetNumThreads(opt.numThreads);
+		VectorT s;
+		Status status = spline.Build(nodes, f);
+		if( status == Status::Success )
+		{
+			spline.Evaluate(nodes, s);
+		}
+		if( !PrintCheck(type, "NormalSpline", nn, ( status == Status::Success ) ? GetError<T>(nn, gram, spline.GetCoefficients().data(), f.data(), s.data()) : failure, nn * eps) )
+		{
+			++failed;
+		}
+
+		// The truncated evaluation at random points differs from the full one by GetErrorBound() at most
+		const int nq = 500;
+		VectorP q;
+		MakeNodes<T>(nq, g, q);
+		VectorT sq, st;
+		double error = failure, bound = 0.0;
+		if( status == Status::Success )
+		{
+			spline.Evaluate(q, sq);
+			spline.SetTruncation(T(1.0e-3));
+			spline.Evaluate(q, st);
+			bound = spline.GetErrorBound();
+			error = 0.0;
+			for( int i = 0; i < nq; ++i )
+			{
+				error = std::max(error, std::abs((double)sq[i] - st[i]));
+			}
+		}
+		if( !PrintCheck(type, "Spline truncation", nq, error, bound) )
+		{
+			++failed;
+		}
+	}
+
+	{
+		// The interpolant of the selected nodes at these nodes, and the residual kept at all the candidates
+		const int maxNodes = 200;
+		Greedy<T, GramDims> greedy(rk);
+		greedy.SetNumThreads(opt.numThreads);
+		VectorT mu;
+		Status status = greedy.Init(nodes, f);
+		if( status == Status::Success )
+		{
+			status = greedy.Run(T(0.0), maxNodes);
+			status = ( status == Status::IterationLimit ) ? Status::Success : status;
+		}
+		if( status == Status::Success )
+		{
+			status = greedy.GetCoefficients(mu);
+		}
+		const std::vector<int>& selected = greedy.GetSelected();
+		int m = (int)selected.size();
+		double error = failure, residual = failure;
+		if( status == Status::Success && m > 0 )
+		{
+			VectorP sn(m);
+			VectorT fs(m);
+			for( int k = 0; k < m; ++k )
+			{
+				sn[k] = nodes[selected[k]];
+				fs[k] = f[selected[k]];
+			}
+			SpdMatrixT gs;
+			Gram<T, GramDims>(rk).Assemble(sn, gs);
+			error = GetError<T>(m, gs, mu.data(), fs.data(), nullptr);
+
+			const VectorT& r = greedy.GetResidual();
+			double d = 0.0, scale = 0.0;
+			for( int i = 0; i < nn; ++i )
+			{
+				double sigma = 0.0, s = std::abs((double)f[i]);
+				for( int k = 0; k < m; ++k )
+				{
+					double v = (double)rk.GetValue(nodes[i], sn[k]) * mu[k];
+					sigma += v;
+					s += std::abs(v);
+				}
+				d = std::max(d, std::abs(r[i] - (f[i] - sigma)));
+				scale = std::max(scale, s);
+			}
+			residual = d / scale;
+		}
+		if( !PrintCheck(type, "Greedy nodes", m, error, m * eps) )
+		{
+			++failed;
+		}
+		if( !PrintCheck(type, "Greedy residual", nn, residual, nn * eps) )
+		{
+			++failed;
+		}
+	}
+
+	{
+		// The estimate kept up to date by UpdateAdd and UpdateDel against rcond_2 of the matrix they lead to, it is an
+		// upper bound seen up to about ten times the true one (see SpdChol), so the error is the ratio either way
+		const int m = 400, k = 8;
+		VectorP sn(nodes.begin(), nodes.begin() + m);
+		SpdMatrixT gs;
+		Gram<T, GramDims>(rk).Assemble(sn, gs);
+		SpdChol<T> chol(SpdMatrixT(gs.begin(), gs.begin() + ((Size_T)(m - k)) * (m - k + 1) / 2), m - k);
+		chol.SetNumThreads(opt.numThreads);
+		Status status = chol.Factorize();
+		for( int i = m - k; i < m && status == Status::Success; ++i )
+		{
+			Size_T ii = ((Size_T)i) * (i + 1) / 2;
+			VectorT row(gs.begin() + ii, gs.begin() + ii + i + 1);
+			status = chol.UpdateAdd(row);
+		}
+		double error = failure;
+		if( status == Status::Success )
+		{
+			double q = chol.GetRCondEstimate() / GetRCond2<T>(m, gs, chol);
+			error = std::max(q, 1.0 / q);
+		}
+		if( !PrintCheck(type, "RCondEstimate add", m, error, 10.0) )
+		{
+			++failed;
+		}
+
+		std::vector<int> del;
+		std::vector<bool> deleted(m, false);
+		for( int i = 0; i < m; i += 23 )
+		{
+			del.push_back(i);
+			deleted[i] = true;
+		}
+		SpdMatrixT gr;
+		DeleteRows<T>(m, gs, deleted, gr);
+		int mr = m - (int)del.size();
+		error = failure;
+		if( status == Status::Success && chol.UpdateDel(del) == Status::Success )
+		{
+			double q = chol.GetRCondEstimate() / GetRCond2<T>(mr, gr, chol);
+			error = std::max(q, 1.0 / q);
+		}
+		if( !PrintCheck(type, "RCondEstimate del", mr, error, 10.0) )
+		{
+			++failed;
+		}
+	}
+
+	{
+		// The norms of the threaded helpers do not depend on their number of threads, Reduction<T> and SpMv<T> split
+		// the sums by the size only; the error is the number of the thread counts whose norms differ from one thread
+		const HelperKind kinds[] = { HelperKind::Pool, HelperKind::Omp };
+		const int threads[] = { 1, 2, 3, 8 };
+		VectorT v(100000), x(nn);
+		for( size_t i = 0; i < v.size(); ++i )
+		{
+			v[i] = u(g);
+		}
+		for( int i = 0; i < nn; ++i )
+		{
+			x[i] = u(g);
+		}
+		for( int k = 0; k < 2; ++k )
+		{
+			if( !Helpers<T>::IsAvailable(kinds[k]) )
+			{
+				continue;
+			}
+			T norm = T(0.0), residual = T(0.0);
+			int differ = 0;
+			for( int t = 0; t < 4; ++t )
+			{
+				std::unique_ptr<IHelper<T>> helper = Helpers<T>::Create(kinds[k], threads[t]);
+				T vn = helper->GetVectorNorm2((int)v.size(), v);
+				T rn = helper->GetResidualNorm2(nn, gram, x, f);
+				if( t == 0 )
+				{
+					norm = vn;
+					residual = rn;
+				}
+				else if( vn != norm || rn != residual )
+				{
+					++differ;
+				}
+			}
+			std::string check = std::string(Helpers<T>::GetName(kinds[k])) + " norms";
+			if( !PrintCheck(type, check.c_str(), nn, differ, 0.0) )
+			{
+				++failed;
+			}
+		}
+	}
+
+	{
+		// The H-matrix product against the dense one, the blocks are approximated up to about tolH
+		// eta and the leaf size are set so that there are low-rank blocks for this number of nodes
+		const double tolH = ( eps < 1.0e-10 ) ? 1.0e-8 : 1.0e-4;
+		HMatrix<T, GramDims> h(rk);
+		h.SetNumThreads(opt.numThreads);
+		h.SetEta(T(2.0));
+		h.SetLeafSize(32);
+		VectorT x(nn), y(nn);
+		for( int i = 0; i < nn; ++i )
+		{
+			x[i] = u(g);
+		}
+		Status status = h.Build(nodes, T(tolH));
+		if( status == Status::Success )
+		{
+			h.Multiply(x.data(), y.data());
+		}
+		if( !PrintCheck(type, "HMatrix", nn, ( status == Status::Success ) ? GetError<T>(nn, gram, x.data(), y.data(), nullptr) : failure, 10.0 * tolH) )
+		{
+			++failed;
+		}
+	}
+
+	return failed;
+}
+
+void PrintResult(const BenchResult& r)
+{
+	double gflops = ( r.flops > 0.0 && r.seconds > 0.0 ) ? 1.0e-9 * r.flops / r.seconds : 0.0;
+	double gbps = ( r.bytes > 0.0 && r.seconds > 0.0 ) ? 1.0e-9 * r.bytes / r.seconds : 0.0;
+	cout << std::left << std::setw(7) << r.type << std::setw(8) << r.matrix << std::setw(7) << r.n << std::setw(9) << r.helper << std::setw(16) << r.op << std::right;
+	SetPrintParams(12, 4);
+	cout << 1.0e3 * r.seconds;
+	SetPrintParams(10, 2);
+	cout << gflops;
+	SetPrintParams(10, 2);
+	cout << gbps;
+	cout << std::setw(8) << r.status << endl;
+}
+
+bool WriteCsv(const std::string& file, const std::vector<BenchResult>& results)
+{
+	std::ofstream os(file.c_str());
+	if( !os )
+	{
+		return false;
+	}
+	os << "type,matrix,n,helper,op,seconds,flops,bytes,gflops,gbps,status" << endl;
+	os << std::setprecision(9);
+	for( size_t i = 0; i < results.size(); ++i )
+	{
+		const BenchResult& r = results[i];
+		double gflops = ( r.seconds > 0.0 ) ? 1.0e-9 * r.flops / r.seconds : 0.0;
+		double gbps = ( r.seconds > 0.0 ) ? 1.0e-9 * r.bytes / r.seconds : 0.0;
+		os << r.type << ',' << r.matrix << ',' << r.n << ',' << r.helper << ',' << r.op << ',' << r.seconds << ',' << r.flops << ','
+		   << r.bytes << ',' << gflops << ',' << gbps << ',' << r.status << endl;
+	}
+	return true;
+}
+
+bool WriteJson(const std::string& file, const std::string& tag, const std::vector<BenchResult>& results)
+{
+// The tag (a commit hash, say) is written as is, it must not contain quotes
+	std::ofstream os(file.c_str());
+	if( !os )
+	{
+		return false;
+	}
+	os << std::setprecision(9);
+	os << "{" << endl << "  \"tag\": \"" << tag << "\"," << endl << "  \"results\": [" << endl;
+	for( size_t i = 0; i < results.size(); ++i )
+	{
+		const BenchResult& r = results[i];
+		double gflops = ( r.seconds > 0.0 ) ? 1.0e-9 * r.flops / r.seconds : 0.0;
+		double gbps = ( r.seconds > 0.0 ) ? 1.0e-9 * r.bytes / r.seconds : 0.0;
+		os << "    {\"type\": \"" << r.type << "\", \"matrix\": \"" << r.matrix << "\", \"n\": " << r.n << ", \"helper\": \"" << r.helper
+		   << "\", \"op\": \"" << r.op << "\", \"seconds\": " << r.seconds << ", \"flops\": " << r.flops << ", \"bytes\": " << r.bytes
+		   << ", \"gflops\": " << gflops << ", \"gbps\": " << gbps << ", \"status\": " << r.status << "}"
+		   << ( ( i + 1 < results.size() ) ? "," : "" ) << endl;
+	}
+	os << "  ]" << endl << "}" << endl;
+	return true;
+}
+
 void SetPrintParams(int width, int precision, std::ios::fmtflags fmt)
 {
 	cout.setf(fmt);
 	cout.width(width);
 	cout.precision(precision);
 }
-
-